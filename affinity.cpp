@@ -0,0 +1,155 @@
+/**\file   affinity.cpp
+ * \date   October 16, 2026
+ *
+ * sysfs topology and sched_setaffinity. A CPU whose topology can't be
+ * read counts as a core of its own on node 0, which is what a machine
+ * without NUMA looks like anyway.
+ */
+
+#include "affinity.h"
+#include <algorithm>         //!< Ordering cores
+#include <cstdio>            //!< Reading sysfs
+#include <map>               //!< Threads of each core
+#include <dirent.h>          //!< Finding a CPU's node
+#include <sched.h>           //!< sched_getaffinity, sched_setaffinity
+
+/** One physical core and its hardware threads, lowest numbered first */
+struct coreInfo{
+    int              node;
+    int              package;
+    int              core;
+    std::vector<int> cpus;
+
+    bool operator<(const coreInfo& o) const{
+        if(node != o.node){
+            return node < o.node;
+        }
+        if(package != o.package){
+            return package < o.package;
+        }
+        return core < o.core;
+    }
+};
+
+/** An integer from a sysfs file, fallback if there isn't one */
+static int readInt(const std::string& path, int fallback){
+    FILE* f = fopen(path.c_str(), "r");
+    int   v = fallback;
+    if(f){
+        if(fscanf(f, "%d", &v) != 1){
+            v = fallback;
+        }
+        fclose(f);
+    }
+    return v;
+}
+
+int cpuNode(int cpu){
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR*        d   = opendir(dir.c_str());
+    int         node = 0;
+    if(!d){
+        return 0;
+    }
+    // The node shows up as a nodeN link among the CPU's entries
+    while(dirent* e = readdir(d)){
+        if(sscanf(e->d_name, "node%d", &node) == 1){
+            break;
+        }
+        node = 0;
+    }
+    closedir(d);
+    return node;
+}
+
+/** The cores this process may run on, sorted by node, package and core */
+static std::vector<coreInfo> readCores(){
+    cpu_set_t                               allowed;
+    std::map<std::pair<int, int>, coreInfo> byCore;
+    std::vector<coreInfo>                   cores;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+        return cores;
+    }
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++){
+        if(!CPU_ISSET(cpu, &allowed)){
+            continue;
+        }
+        std::string top = "/sys/devices/system/cpu/cpu" +
+            std::to_string(cpu) + "/topology/";
+        int package = readInt(top + "physical_package_id", 0);
+        // Unknown cores are told apart by their CPU number
+        int core    = readInt(top + "core_id", -1 - cpu);
+        coreInfo& c = byCore[std::make_pair(package, core)];
+        if(c.cpus.empty()){
+            c.node    = cpuNode(cpu);
+            c.package = package;
+            c.core    = core;
+        }
+        c.cpus.push_back(cpu);
+    }
+    for(std::map<std::pair<int, int>, coreInfo>::iterator it =
+            byCore.begin(); it != byCore.end(); ++it){
+        cores.push_back(it->second);
+    }
+    std::sort(cores.begin(), cores.end());
+    return cores;
+}
+
+std::vector<int> affinityPlan(affinityMode mode, bool smt){
+    std::vector<int>      cpus;
+    std::vector<coreInfo> cores;
+    if(mode == AFFINITY_NONE){
+        return cpus;
+    }
+    cores = readCores();
+    if(mode == AFFINITY_SCATTER){
+        // Deal the cores out a node at a time
+        std::map<int, std::vector<coreInfo> > byNode;
+        std::vector<coreInfo>                 dealt;
+        for(size_t i = 0; i < cores.size(); i++){
+            byNode[cores[i].node].push_back(cores[i]);
+        }
+        for(size_t k = 0; dealt.size() < cores.size(); k++){
+            for(std::map<int, std::vector<coreInfo> >::iterator it =
+                    byNode.begin(); it != byNode.end(); ++it){
+                if(k < it->second.size()){
+                    dealt.push_back(it->second[k]);
+                }
+            }
+        }
+        cores.swap(dealt);
+    }
+    size_t threads = 1;
+    for(size_t i = 0; smt && i < cores.size(); i++){
+        threads = std::max(threads, cores[i].cpus.size());
+    }
+    for(size_t t = 0; t < threads; t++){
+        for(size_t i = 0; i < cores.size(); i++){
+            if(t < cores[i].cpus.size()){
+                cpus.push_back(cores[i].cpus[t]);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool pinTo(pid_t who, int cpu){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // For a pid of 0 this is the calling thread, not the whole process
+    if(sched_setaffinity(who, sizeof(set), &set) != 0){
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
+
+std::string describePlan(const std::vector<int>& cpus){
+    std::string s;
+    for(size_t i = 0; i < cpus.size(); i++){
+        s += (i ? " " : "") + std::to_string(cpus[i]) + "/" +
+            std::to_string(cpuNode(cpus[i]));
+    }
+    return s;
+}
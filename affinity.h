@@ -0,0 +1,38 @@
+/**\file   affinity.h
+ * \date   October 16, 2026
+ *
+ * Pinning renderers to CPUs. The topology comes from sysfs, so nothing
+ * beyond the C library is needed: which core and package each CPU is
+ * part of, and which NUMA node it sits on. A renderer pinned before it
+ * allocates anything has its memory placed on its own node by the
+ * kernel's first touch policy.
+ */
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>            //!< Describing a plan
+#include <vector>            //!< CPU lists
+#include <sys/types.h>       //!< pid_t
+
+enum affinityMode{
+    AFFINITY_NONE,           //!< Leave scheduling to the kernel
+    AFFINITY_COMPACT,        //!< Fill one node's cores before the next
+    AFFINITY_SCATTER         //!< A core from each node in turn
+};
+
+/**\brief The CPUs to pin renderers to, renderer i on cpus[i % size].
+ *
+ * Every core's first hardware thread comes before any SMT sibling, so
+ * siblings are only shared once the cores run out, and not at all
+ * unless smt. Only CPUs this process may run on are used. Empty for
+ * AFFINITY_NONE.
+ */
+std::vector<int> affinityPlan(affinityMode mode, bool smt);
+//!< NUMA node of a CPU, 0 if sysfs doesn't say
+int              cpuNode(int cpu);
+//!< Pins a process, or the calling thread if who is 0, to one CPU
+bool             pinTo(pid_t who, int cpu);
+//!< The plan as "cpu/node" pairs, for the log
+std::string      describePlan(const std::vector<int>& cpus);
+
+#endif // AFFINITY_H
@@ -0,0 +1,203 @@
+/**\file   batch.cpp
+ * \date   October 16, 2026
+ *
+ * Batch files and the pool the render threads share. A renderer that
+ * finds no job with a tile free waits the way the frame ring does, a
+ * short spin, then yielding, then short sleeps, since a free tile turns
+ * up as soon as a job's writer hands back a frame.
+ */
+
+#include "batch.h"
+#include <cctype>            //!< Splitting lines into words
+#include <cstdio>            //!< Reading the batch file
+#include <sched.h>           //!< sched_yield
+#include <time.h>            //!< nanosleep
+
+//!< Flagfiles read from flagfiles, deeper than this is taken as a loop
+static const int MAX_NESTING = 8;
+
+bool batchJob::find(const std::string& name, std::string* value) const{
+    bool found = false;
+    for(size_t i = 0; i < flags.size(); i++){
+        if(flags[i].first == name){
+            *value = flags[i].second;
+            found  = true;
+        }
+    }
+    return found;
+}
+
+/** Adds the words of a line to a job, reading in any -flagfile. */
+static bool readWords(const std::string& line, const std::string& where,
+        int depth, batchJob* job);
+
+/** Adds every line of a flagfile to a job. */
+static bool readFlagfile(const std::string& path, const std::string& where,
+        int depth, batchJob* job){
+    FILE* f = fopen(path.c_str(), "r");
+    char  buf[4096];
+    int   n = 0;
+    if(!f){
+        fprintf(stderr, "%s: can't read flagfile %s\n", where.c_str(),
+                path.c_str());
+        return false;
+    }
+    bool ok = true;
+    while(ok && fgets(buf, sizeof(buf), f)){
+        n++;
+        ok = readWords(buf, path + ":" + std::to_string(n), depth + 1, job);
+    }
+    fclose(f);
+    return ok;
+}
+
+static bool readWords(const std::string& line, const std::string& where,
+        int depth, batchJob* job){
+    size_t i = 0;
+    if(depth > MAX_NESTING){
+        fprintf(stderr, "%s: flagfiles nested too deep\n", where.c_str());
+        return false;
+    }
+    while(i < line.size()){
+        while(i < line.size() && isspace((unsigned char)line[i])){
+            i++;
+        }
+        if(i == line.size() || line[i] == '#'){
+            break;
+        }
+        size_t end = i;
+        while(end < line.size() && !isspace((unsigned char)line[end])){
+            end++;
+        }
+        std::string word = line.substr(i, end - i);
+        i = end;
+        size_t dashes = word.compare(0, 2, "--") == 0 ? 2 : 1;
+        if(word[0] != '-' || word.size() == dashes){
+            fprintf(stderr, "%s: %s is not a flag\n", where.c_str(),
+                    word.c_str());
+            return false;
+        }
+        size_t      eq    = word.find('=');
+        std::string name  = word.substr(dashes, eq == std::string::npos ?
+                std::string::npos : eq - dashes);
+        std::string value = eq == std::string::npos ? "" :
+            word.substr(eq + 1);
+        if(name == "flagfile"){
+            if(!readFlagfile(value, where, depth, job)){
+                return false;
+            }
+            continue;
+        }
+        job->flags.push_back(std::make_pair(name, value));
+    }
+    return true;
+}
+
+bool readBatch(const std::string& path, std::vector<batchJob>* jobs){
+    FILE* f = fopen(path.c_str(), "r");
+    char  buf[4096];
+    int   n = 0;
+    if(!f){
+        fprintf(stderr, "Can't read batch file %s\n", path.c_str());
+        return false;
+    }
+    bool ok = true;
+    while(ok && fgets(buf, sizeof(buf), f)){
+        batchJob job;
+        n++;
+        job.where = path + ":" + std::to_string(n);
+        ok = readWords(buf, job.where, 0, &job);
+        if(ok && !job.flags.empty()){
+            jobs->push_back(job);
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+batchPool::batchPool() : turn(0), done(false){
+    pthread_mutex_init(&lock, NULL);
+}
+
+batchPool::~batchPool(){
+    pthread_mutex_destroy(&lock);
+}
+
+void batchPool::open(void* job, int cap){
+    openJob j = {job, cap, 0};
+    pthread_mutex_lock(&lock);
+    jobs.push_back(j);
+    pthread_mutex_unlock(&lock);
+}
+
+bool batchPool::close(void* job){
+    bool closed = false;
+    pthread_mutex_lock(&lock);
+    for(size_t i = 0; i < jobs.size(); i++){
+        if(jobs[i].job == job && jobs[i].busy == 0){
+            jobs.erase(jobs.begin() + i);
+            closed = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return closed;
+}
+
+void* batchPool::pick(claimFn claim, void* out){
+    int tries = 0;
+    while(!done.load()){
+        void* got = NULL;
+        pthread_mutex_lock(&lock);
+        order.clear();
+        for(size_t k = 0; k < jobs.size(); k++){
+            size_t i = (turn + k) % jobs.size();
+            if(jobs[i].busy >= jobs[i].cap){
+                continue;
+            }
+            // Least served first, after equals so they keep taking turns
+            size_t at = order.size();
+            while(at > 0 && jobs[order[at - 1]].busy > jobs[i].busy){
+                at--;
+            }
+            order.insert(order.begin() + at, i);
+        }
+        for(size_t k = 0; !got && k < order.size(); k++){
+            openJob& j = jobs[order[k]];
+            if(claim(j.job, out)){
+                j.busy++;
+                got  = j.job;
+                turn = order[k] + 1;
+            }
+        }
+        pthread_mutex_unlock(&lock);
+        if(got){
+            return got;
+        }
+        if(tries < 64){
+            // spin
+        }else if(tries < 256){
+            sched_yield();
+        }else{
+            timespec t = {0, 100000};
+            nanosleep(&t, NULL);
+        }
+        tries++;
+    }
+    return NULL;
+}
+
+void batchPool::leave(void* job){
+    pthread_mutex_lock(&lock);
+    for(size_t i = 0; i < jobs.size(); i++){
+        if(jobs[i].job == job){
+            jobs[i].busy--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void batchPool::finish(){
+    done.store(true);
+}
@@ -0,0 +1,73 @@
+/**\file   batch.h
+ * \date   October 16, 2026
+ *
+ * Many zooms rendered by one set of render threads. A batch file lists
+ * the jobs, one to a line, each a list of flags in the same form as on
+ * the command line, with -flagfile read in where it appears. The render
+ * threads are shared out between the jobs open at once, so while one
+ * job's last frames finish on a few of them the next job already keeps
+ * the rest busy.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <atomic>            //!< Telling idle renderers to go home
+#include <string>            //!< Flag names and values
+#include <utility>           //!< Flags paired with their values
+#include <vector>            //!< Jobs and their flags
+#include <pthread.h>         //!< Guarding who works on what
+
+/** One line of a batch file. */
+struct batchJob{
+    std::string where;       //!< File and line, for error messages
+    //!< Flag names without their dashes, in the order given, values as
+    //!< written. A flag given without =value has an empty value.
+    std::vector<std::pair<std::string, std::string> > flags;
+
+    //!< Whether name was given, and if so its last value in *value
+    bool find(const std::string& name, std::string* value) const;
+};
+
+//!< Reads the jobs from a batch file. Blank lines and lines starting
+//!< with # are skipped. false, after saying why, if it can't be read.
+bool readBatch(const std::string& path, std::vector<batchJob>* jobs);
+
+/** Shares renderers between the jobs open at once. A renderer asks for
+ * work with pick(), which offers each open job a tile, the jobs with
+ * the fewest renderers first and in turn among equals. Each job has at
+ * most its cap of renderers at once, counted from pick() to leave().
+ */
+class batchPool{
+public:
+    //!< Hands a renderer a tile of job into out, false if job has none
+    //!< free right now
+    typedef bool (*claimFn)(void* job, void* out);
+
+    batchPool();
+    ~batchPool();
+
+    void  open(void* job, int cap);
+    //!< Forgets a job, false while a renderer is still on it
+    bool  close(void* job);
+    //!< Waits for a job to hand over a tile into out and returns the
+    //!< job, or NULL once finish() has been called
+    void* pick(claimFn claim, void* out);
+    void  leave(void* job);
+    //!< Sends every renderer waiting in pick() home
+    void  finish();
+
+private:
+    struct openJob{
+        void* job;
+        int   cap;
+        int   busy;          //!< Renderers on it now
+    };
+
+    pthread_mutex_t      lock;
+    std::vector<openJob> jobs;
+    std::vector<int>     order;   //!< pick()'s working
+    size_t               turn;    //!< Job to offer first among equals
+    std::atomic<bool>    done;
+};
+
+#endif // BATCH_H
@@ -0,0 +1,217 @@
+/**\file   ddouble.h
+ * \date   October 16, 2026
+ *
+ * Double-double (about 106 bits) and quad-double (about 212 bits)
+ * numbers, kept as unevaluated sums of doubles and built on the error
+ * free TwoSum and TwoProd transformations. TwoProd needs a hardware
+ * fused multiply-add to be fast. Everything is inline and branch free
+ * so loops over arrays of them vectorize across pixels, which is far
+ * cheaper than boost::multiprecision for the same precision.
+ *
+ * The algorithms follow Hida, Li and Bailey's QD library. Quad-double
+ * uses the "sloppy" add and multiply and renormalizes without the
+ * checks for zero parts, which costs a few of the bottom bits.
+ */
+#ifndef DDOUBLE_H
+#define DDOUBLE_H
+
+#include <cmath>             //!< fma
+
+/** s + e == a + b exactly */
+inline double twoSum(double a, double b, double* e){
+    double s  = a + b;
+    double bb = s - a;
+    *e = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+/** s + e == a + b exactly, provided |a| >= |b| */
+inline double quickTwoSum(double a, double b, double* e){
+    double s = a + b;
+    *e = b - (s - a);
+    return s;
+}
+
+/** p + e == a * b exactly */
+inline double twoProd(double a, double b, double* e){
+    double p = a * b;
+    *e = std::fma(a, b, -p);
+    return p;
+}
+
+struct dd{
+    double hi;               //!< Leading part
+    double lo;               //!< Error of the leading part
+
+    dd(){
+    }
+    dd(double h, double l = 0.0){
+        hi = h;
+        lo = l;
+    }
+    //!< Keeps all 64 bits of a long double
+    explicit dd(long double v){
+        hi = (double)v;
+        lo = (double)(v - hi);
+    }
+};
+
+inline dd operator+(dd a, dd b){
+    double e, f;
+    double s = twoSum(a.hi, b.hi, &e);
+    double t = twoSum(a.lo, b.lo, &f);
+    e += t;
+    s  = quickTwoSum(s, e, &e);
+    e += f;
+    s  = quickTwoSum(s, e, &e);
+    return dd(s, e);
+}
+
+inline dd operator-(dd a){
+    return dd(-a.hi, -a.lo);
+}
+
+inline dd operator-(dd a, dd b){
+    return a + -b;
+}
+
+inline dd operator*(dd a, dd b){
+    double e;
+    double p = twoProd(a.hi, b.hi, &e);
+    e += a.hi * b.lo + a.lo * b.hi;
+    p  = quickTwoSum(p, e, &e);
+    return dd(p, e);
+}
+
+inline dd sqr(dd a){
+    double e;
+    double p = twoProd(a.hi, a.hi, &e);
+    e += 2.0 * a.hi * a.lo;
+    p  = quickTwoSum(p, e, &e);
+    return dd(p, e);
+}
+
+//!< Exact doubling, used for the 2xy term
+inline dd twice(dd a){
+    return dd(2.0 * a.hi, 2.0 * a.lo);
+}
+
+inline double toDouble(dd a){
+    return a.hi;
+}
+
+//!< The sign of a dd is its leading part's, flipped with a select
+inline dd absolute(dd a){
+    double s = a.hi < 0.0 ? -1.0 : 1.0;
+    return dd(s * a.hi, s * a.lo);
+}
+
+struct qd{
+    double x[4];             //!< Parts in decreasing magnitude
+
+    qd(){
+    }
+    qd(double a, double b = 0.0, double c = 0.0, double d = 0.0){
+        x[0] = a;
+        x[1] = b;
+        x[2] = c;
+        x[3] = d;
+    }
+    explicit qd(long double v){
+        x[0] = (double)v;
+        x[1] = (double)(v - x[0]);
+        x[2] = 0.0;
+        x[3] = 0.0;
+    }
+};
+
+/** a + b + c as a + b with c the leftover error */
+inline void threeSum(double* a, double* b, double* c){
+    double t1, t2, t3;
+    t1 = twoSum(*a, *b, &t2);
+    *a = twoSum(*c, t1, &t3);
+    *b = twoSum(t2, t3, c);
+}
+
+/** threeSum when only two words of the result are wanted */
+inline void threeSum2(double* a, double* b, double* c){
+    double t1, t2, t3;
+    t1 = twoSum(*a, *b, &t2);
+    *a = twoSum(*c, t1, &t3);
+    *b = t2 + t3;
+}
+
+/** Folds five overlapping parts into four non-overlapping ones */
+inline qd renorm(double c0, double c1, double c2, double c3, double c4){
+    double s;
+    s  = quickTwoSum(c3, c4, &c4);
+    s  = quickTwoSum(c2, s, &c3);
+    s  = quickTwoSum(c1, s, &c2);
+    c0 = quickTwoSum(c0, s, &c1);
+    c1 = quickTwoSum(c1, c2, &c2);
+    c2 = quickTwoSum(c2, c3, &c3);
+    c3 += c4;
+    return qd(c0, c1, c2, c3);
+}
+
+inline qd operator+(qd a, qd b){
+    double t0, t1, t2, t3;
+    double s0 = twoSum(a.x[0], b.x[0], &t0);
+    double s1 = twoSum(a.x[1], b.x[1], &t1);
+    double s2 = twoSum(a.x[2], b.x[2], &t2);
+    double s3 = twoSum(a.x[3], b.x[3], &t3);
+    s1 = twoSum(s1, t0, &t0);
+    threeSum(&s2, &t0, &t1);
+    threeSum2(&s3, &t0, &t2);
+    t0 = t0 + t1 + t3;
+    return renorm(s0, s1, s2, s3, t0);
+}
+
+inline qd operator-(qd a){
+    return qd(-a.x[0], -a.x[1], -a.x[2], -a.x[3]);
+}
+
+inline qd operator-(qd a, qd b){
+    return a + -b;
+}
+
+inline qd operator*(qd a, qd b){
+    double q0, q1, q2, q3, q4, q5;
+    double t0, t1;
+    double p0 = twoProd(a.x[0], b.x[0], &q0);
+    double p1 = twoProd(a.x[0], b.x[1], &q1);
+    double p2 = twoProd(a.x[1], b.x[0], &q2);
+    double p3 = twoProd(a.x[0], b.x[2], &q3);
+    double p4 = twoProd(a.x[1], b.x[1], &q4);
+    double p5 = twoProd(a.x[2], b.x[0], &q5);
+    threeSum(&p1, &p2, &q0);
+    threeSum(&p2, &q1, &q2);
+    threeSum(&p3, &p4, &p5);
+    double s0 = twoSum(p2, p3, &t0);
+    double s1 = twoSum(q1, p4, &t1);
+    double s2 = q2 + p5;
+    s1  = twoSum(s1, t0, &t0);
+    s2 += t0 + t1;
+    s1 += a.x[0] * b.x[3] + a.x[1] * b.x[2] + a.x[2] * b.x[1] +
+          a.x[3] * b.x[0] + q0 + q3 + q4 + q5;
+    return renorm(p0, p1, s0, s1, s2);
+}
+
+inline qd sqr(qd a){
+    return a * a;
+}
+
+inline qd twice(qd a){
+    return qd(2.0 * a.x[0], 2.0 * a.x[1], 2.0 * a.x[2], 2.0 * a.x[3]);
+}
+
+inline double toDouble(qd a){
+    return a.x[0];
+}
+
+inline qd absolute(qd a){
+    double s = a.x[0] < 0.0 ? -1.0 : 1.0;
+    return qd(s * a.x[0], s * a.x[1], s * a.x[2], s * a.x[3]);
+}
+
+#endif // DDOUBLE_H
@@ -0,0 +1,129 @@
+/**\file   framepool.cpp
+ * \date   October 16, 2026
+ *
+ * Every buffer is a mapping of its own. One of at least a huge page is
+ * rounded up to a whole number of them and aligned to one, so
+ * transparent huge pages can back all of it; smaller ones would mostly
+ * be padding, so they get ordinary pages. Free buffers are kept for the
+ * size they are, since a program that needed them once will want them
+ * again, until a buffer of another size is asked for. That is a change
+ * of resolution, and the old size's free buffers are unmapped then.
+ * The free lists are allocated rather than static so buffers handed
+ * back by static objects while the program exits don't outlive them.
+ */
+
+#include "framepool.h"
+#include <cstdio>            //!< perror
+#include <map>               //!< Free buffers by size
+#include <vector>            //!< Free buffers of one size
+#include <pthread.h>         //!< Guarding the free lists
+#include <sys/mman.h>        //!< mmap, madvise
+
+//!< Huge page size assumed for alignment, 2 MiB on x86-64
+static const size_t HUGE_PAGE = 2 << 20;
+
+static hugePages       mode   = HUGE_TRANSPARENT;
+static bool            warned = false;    // explicit pages ran out
+static pthread_mutex_t lock   = PTHREAD_MUTEX_INITIALIZER;
+static std::map<uint64_t, std::vector<uint64_t*> >* spare  = NULL;
+//!< Pixels and mapped bytes of every buffer handed out
+static std::map<uint64_t*, std::pair<uint64_t, size_t> >* pixels = NULL;
+
+void framePages(hugePages huge){
+    mode = huge;
+}
+
+void* mapFrames(size_t* bytes, bool shared){
+    int       flags = MAP_ANONYMOUS | (shared ? MAP_SHARED : MAP_PRIVATE);
+    void*     m;
+    // Less than a huge page isn't worth padding out to one
+    hugePages huge  = *bytes < HUGE_PAGE ? HUGE_OFF : mode;
+    if(huge != HUGE_OFF){
+        *bytes = (*bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+    }
+    if(huge == HUGE_EXPLICIT){
+        m = mmap(NULL, *bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+                -1, 0);
+        if(m != MAP_FAILED){
+            return m;
+        }
+        if(!warned){
+            perror("huge pages, using transparent ones");
+            warned = true;
+        }
+    }
+    // Map a huge page extra and trim it off so the rest is aligned
+    size_t over = *bytes + (huge == HUGE_OFF ? 0 : HUGE_PAGE);
+    char*  c    = (char*)mmap(NULL, over, PROT_READ | PROT_WRITE, flags, -1,
+            0);
+    if(c == MAP_FAILED){
+        return NULL;
+    }
+    if(huge == HUGE_OFF){
+        return c;
+    }
+    size_t head = (HUGE_PAGE - (uintptr_t)c % HUGE_PAGE) % HUGE_PAGE;
+    if(head){
+        munmap(c, head);
+    }
+    munmap(c + head + *bytes, over - head - *bytes);
+    madvise(c + head, *bytes, MADV_HUGEPAGE);
+    return c + head;
+}
+
+void unmapFrames(void* m, size_t bytes){
+    munmap(m, bytes);
+}
+
+uint64_t* takeFrame(uint64_t count){
+    uint64_t*                                 buf = NULL;
+    std::vector<std::pair<uint64_t*, size_t> > stale;
+    pthread_mutex_lock(&lock);
+    if(!spare){
+        spare  = new std::map<uint64_t, std::vector<uint64_t*> >;
+        pixels = new std::map<uint64_t*, std::pair<uint64_t, size_t> >;
+    }
+    // Free buffers of another size are from before a change of size
+    for(std::map<uint64_t, std::vector<uint64_t*> >::iterator it =
+            spare->begin(); it != spare->end(); ++it){
+        for(size_t i = 0; it->first != count && i < it->second.size(); i++){
+            stale.push_back(std::make_pair(it->second[i],
+                        (*pixels)[it->second[i]].second));
+            pixels->erase(it->second[i]);
+        }
+        if(it->first != count){
+            it->second.clear();
+        }
+    }
+    std::vector<uint64_t*>& free = (*spare)[count];
+    if(!free.empty()){
+        buf = free.back();
+        free.pop_back();
+    }
+    pthread_mutex_unlock(&lock);
+    for(size_t i = 0; i < stale.size(); i++){
+        unmapFrames(stale[i].first, stale[i].second);
+    }
+    if(buf){
+        return buf;
+    }
+    size_t bytes = count * sizeof(uint64_t);
+    buf = (uint64_t*)mapFrames(&bytes, false);
+    if(!buf){
+        perror("frame buffer");
+        return NULL;
+    }
+    pthread_mutex_lock(&lock);
+    (*pixels)[buf] = std::make_pair(count, bytes);
+    pthread_mutex_unlock(&lock);
+    return buf;
+}
+
+void giveFrame(uint64_t* buf){
+    if(!buf){
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    (*spare)[(*pixels)[buf].first].push_back(buf);
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,39 @@
+/**\file   framepool.h
+ * \date   October 16, 2026
+ *
+ * Frame sized buffers, mapped straight from the kernel rather than the
+ * heap so they can be backed by huge pages, and recycled rather than
+ * freed. A 4K frame of counts spans thousands of 4 KiB pages but only a
+ * few dozen 2 MiB ones, which the TLB can hold all of. Buffers smaller
+ * than a huge page get ordinary pages rather than being padded out.
+ * Free buffers are kept for reuse until a buffer of another size is
+ * asked for, when a change of resolution unmaps them.
+ */
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <cstddef>           //!< size_t
+#include <cstdint>           //!< Fixed width integers
+
+/** How frame buffers are backed */
+enum hugePages{
+    HUGE_OFF,                //!< Ordinary pages
+    HUGE_TRANSPARENT,        //!< Ask for transparent huge pages
+    HUGE_EXPLICIT            //!< Reserved huge pages, MAP_HUGETLB
+};
+
+//!< Sets how mappings made from now on are backed
+void      framePages(hugePages huge);
+//!< Maps at least *bytes of zeroed memory, aligned to a huge page if it
+//!< is at least one, and sets *bytes to what was mapped. shared mappings
+//!< are shared with processes forked afterwards. NULL on failure.
+void*     mapFrames(size_t* bytes, bool shared);
+//!< Unmaps what mapFrames() returned, with the size it gave back
+void      unmapFrames(void* m, size_t bytes);
+//!< A buffer of pixels counts, 64 byte aligned, reused if one is free.
+//!< Free buffers of other sizes are unmapped.
+uint64_t* takeFrame(uint64_t pixels);
+//!< Hands a buffer from takeFrame() back to be reused
+void      giveFrame(uint64_t* buf);
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,59 @@
+/**\file   hpfloat.h
+ * \date   October 16, 2026
+ *
+ * The arbitrary precision type the view is carried in, from parsing the
+ * flags to building each frame's centre, and conversions from it into
+ * every number type a kernel runs in. boost::multiprecision is slow,
+ * but it only ever does a handful of operations per tile.
+ */
+#ifndef HPFLOAT_H
+#define HPFLOAT_H
+
+#include <boost/multiprecision/cpp_bin_float.hpp>
+#include "ddouble.h"         //!< Double-double and quad-double
+#include "widefixed.h"       //!< Fixed point
+
+/** 256 decimal digits, enough for the ~230 digit centres in ex1.txt */
+typedef boost::multiprecision::number<
+    boost::multiprecision::cpp_bin_float<256> > hpfloat;
+
+inline void fromHp(const hpfloat& v, float* out){
+    *out = v.convert_to<float>();
+}
+
+inline void fromHp(const hpfloat& v, double* out){
+    *out = v.convert_to<double>();
+}
+
+inline void fromHp(const hpfloat& v, long double* out){
+    *out = v.convert_to<long double>();
+}
+
+inline void fromHp(const hpfloat& v, dd* out){
+    out->hi = v.convert_to<double>();
+    out->lo = hpfloat(v - out->hi).convert_to<double>();
+}
+
+inline void fromHp(const hpfloat& v, qd* out){
+    hpfloat r = v;
+    for(int k = 0; k < 4; k++){
+        out->x[k] = r.convert_to<double>();
+        r -= out->x[k];
+    }
+}
+
+/** Rounds towards zero at the last fraction bit */
+template<int N>
+inline void fromHp(const hpfloat& v, wideFixed<N>* out){
+    hpfloat a = ldexp(abs(v), wideFixed<N>::TOP);
+    for(int k = N - 1; k >= 0; k--){
+        hpfloat w = trunc(a);
+        out->l[k] = w.convert_to<uint64_t>();
+        a = ldexp(hpfloat(a - w), 64);
+    }
+    if(v < 0){
+        out->negateIf(~0ULL);
+    }
+}
+
+#endif // HPFLOAT_H
@@ -3,32 +3,138 @@
  * \date   May 9, 2015
  *
  * Draws a mandelbrot fractal on screen using SDL.
- * Also requires boost::multiprecision even though it is very slow,
- * it provides access to quad precision math.
+ * Deep zooms can use double-double or quad-double kernels, which give
+ * quad precision math far faster than boost::multiprecision.
  */
 
 #include <cstdio>            //!< For writing out to console
 #include <cstdint>           //!< Fixed width integers
 #include <cassert>           //!< Error Checking
 #include <cstdlib>           //!< Standard Library
+#include <cstring>           //!< Reading back the checkpoint
+#include <cfloat>            //!< Mantissa sizes for picking a kernel
+#include <vector>            //!< Pixels the float kernel has to redo
+#include <ctime>             //!< Timing benchmarks
+#include <unistd.h>          //!< fsync for the checkpoint
 #include <SDL/SDL.h>         //!< Visible window to view the zoom
 #include <pthread.h>         //!< Multithreading library
 #include <gflags/gflags.h>   //!< Parsing the commandline flags
+#include "shard.h"           //!< Rendering frames in other processes
+#include "ring.h"            //!< Handing finished frames to the screen
+#include "ddouble.h"         //!< Double-double and quad-double kernels
+#include "widefixed.h"       //!< Fixed point kernels
+#include "hpfloat.h"         //!< Full precision view coordinates
+#include "trace.h"           //!< Timing the phases of each frame
+#include "perf.h"            //!< Hardware counters per kernel and tile
+#include "tilecost.h"        //!< Time and iterations per tile
+#include "schedule.h"        //!< Planning the pieces of each frame
+#include "affinity.h"        //!< Pinning renderers to CPUs
+#include "framepool.h"       //!< Huge page backed frame buffers
+#include "batch.h"           //!< Many zooms sharing the render threads
+#include <algorithm>         //!< Sorting for percentiles
+#include <sys/wait.h>        //!< Reaping -shm worker processes
 
-long double XMIN = -2.5; 
-long double XMAX = 1.0;
-long double YMIN = -1.0;
-long double YMAX = 1.0;
-
-DEFINE_double(orgX, -.75, "x-axis center point of the image");
-DEFINE_double(orgY, 0, "y-axis center point of the image");
-DEFINE_double(DX, 3.5, "x-axis diameter of the grid to display");
-DEFINE_double(DY, 2, "y-axis diameter of grid to display");
-DEFINE_double(ZOOM, .05, "Percent to zoom in each iteration");
+// The view is parsed from strings so none of its digits are lost to a
+// double on the way in.
+DEFINE_string(orgX, "-.75", "x-axis center point of the image");
+DEFINE_string(orgY, "0", "y-axis center point of the image");
+DEFINE_string(DX, "3.5", "x-axis diameter of the grid to display");
+DEFINE_string(DY, "2", "y-axis diameter of grid to display");
+DEFINE_string(ZOOM, ".05", "Percent to zoom in each iteration");
 DEFINE_int32(screen_width, 800, "The width of the screen");
-
-#define DX FLAGS_DX
-#define DY FLAGS_DY
+DEFINE_string(checkpoint, "", "File to record the zoom state in after "
+        "every frame, empty to disable");
+DEFINE_bool(resume, false, "Continue from the frame after the one "
+        "recorded in the checkpoint file");
+DEFINE_int32(procs, 0, "Worker processes to shard frames across, 0 "
+        "renders with threads in this process");
+DEFINE_int32(shard_port, 0, "Port the shard coordinator listens on, 0 "
+        "picks a free one");
+DEFINE_string(shard_bind, "127.0.0.1", "Address the shard coordinator "
+        "listens on");
+DEFINE_int32(shard_depth, 2, "Frames queued on each shard worker");
+DEFINE_bool(shm, false, "With -procs, hand frames back through the shared "
+        "memory frame ring instead of sockets");
+DEFINE_int32(ahead, 8, "Frames the renderers may get ahead of the one "
+        "being drawn, the number of buffers in the frame ring");
+DEFINE_int32(tile, 64, "Width and height in pixels of the tiles a frame is "
+        "split into between the render threads");
+DEFINE_string(schedule, "cost", "How frames are cut up between the render "
+        "threads: cost plans each frame from the iterations of the one "
+        "-ahead frames before, grid renders the tiles in order");
+DEFINE_string(affinity, "none", "Pin each renderer to a CPU: none, compact "
+        "fills one NUMA node's cores before the next, scatter deals cores "
+        "out across the nodes");
+DEFINE_bool(smt, true, "Let -affinity put renderers on SMT siblings once "
+        "every core has one");
+DEFINE_string(huge_pages, "transparent", "Pages backing frame buffers: "
+        "transparent asks for transparent huge pages, explicit maps "
+        "reserved ones, falling back to transparent, off uses small ones");
+DEFINE_int32(aa, 1, "Anti-alias with up to aa by aa jittered samples in "
+        "each pixel whose count differs from a neighbour's, 1 is off");
+DEFINE_int32(aa_threshold, 2, "How far a pixel's count may be from a "
+        "neighbour's before -aa samples it, -1 samples every pixel");
+DEFINE_bool(smooth, false, "Colour by a continuous escape time worked out "
+        "from where each point escaped, rather than in bands of counts");
+DEFINE_bool(distance, false, "Estimate each pixel's distance to the set "
+        "and draw the boundary as a dark line, letting -aa pick edges by it");
+DEFINE_bool(equalize, false, "Spread the colours over each frame's "
+        "histogram of counts, so they stay apart however deep the zoom");
+DEFINE_bool(boundary, false, "Iterate only the pixels along the edges "
+        "between bands of one count and fill the bands in from them. Exact "
+        "only with -boundary_grid=1, coarser grids are a lossy preview");
+DEFINE_int32(boundary_grid, 1, "With -boundary, also iterate every "
+        "boundary_grid'th pixel across and down, to find bands that no "
+        "edge leads to. 1, every pixel, gives the counts a full render "
+        "does; above 1 or 0 for none is a faster preview that can fill over "
+        "bands smaller than the grid");
+DEFINE_string(formula, "mandelbrot", "Set to draw: mandelbrot, julia, "
+        "multibrot or burning_ship");
+DEFINE_int32(power, 3, "Power of z for -formula=multibrot, 3 or 4");
+DEFINE_double(julia_x, -0.8, "Real part of c for -formula=julia");
+DEFINE_double(julia_y, 0.156, "Imaginary part of c for -formula=julia");
+DEFINE_double(fps, 0, "Frames per second to draw at, 0 draws each frame as "
+        "soon as it is ready");
+DEFINE_string(kernel, "auto", "Number type the escape time kernel runs in: "
+        "float, double, ld (long double), dd (double-double), qd "
+        "(quad-double), fixed (128 to 256 bit fixed point, sized to the "
+        "zoom) or auto (the cheapest that resolves each frame)");
+DEFINE_string(isa, "auto", "Instruction set the kernels run with: sse2, "
+        "avx2, avx512 or auto (the best this CPU has)");
+DEFINE_bool(check_kernels, false, "Render the reference views in float and "
+        "in double for the frames auto would use float on, report the "
+        "pixels that differ and exit");
+DEFINE_bool(bench, false, "Time the kernels, colouring and setScale, "
+        "print a JSON report on stdout and exit");
+DEFINE_double(bench_time, 0.5, "Seconds to repeat each benchmark for");
+DEFINE_string(golden, "", "check renders the golden views with every "
+        "kernel and compares them with the golden data, update rewrites "
+        "the golden data in quad-double");
+DEFINE_string(golden_dir, "golden", "Directory the golden data live in");
+DEFINE_double(golden_tolerance, 0.001, "Fraction of pixels a kernel may get "
+        "wrong on a golden view it resolves");
+DEFINE_string(trace, "", "Write a Chrome trace of each frame's phases to "
+        "this file and print percentiles of them at exit");
+DEFINE_bool(perf, false, "Count cycles, instructions, cache misses and FP "
+        "assists per kernel and tile with perf_event_open and report them "
+        "at exit");
+DEFINE_int32(perf_fp_assist, 0x1eca, "Raw PMU event counted as FP assists, "
+        "umask << 8 | event, the default is FP_ASSIST.ANY on Sandy Bridge "
+        "to Broadwell");
+DEFINE_string(heatmap, "", "Record time and iterations per tile and "
+        "renderer, and at exit write PREFIX-pixels.bmp, PREFIX-tiles.bmp, "
+        "a per frame PREFIX.csv and a load imbalance summary");
+DEFINE_string(connect, "", "Run as a shard worker for the coordinator at "
+        "host:port instead of opening a window");
+DEFINE_string(batch, "", "Render each zoom listed in this file, a line of "
+        "flags per zoom, with the render threads shared between them and no "
+        "window");
+DEFINE_int32(batch_open, 2, "Batch zooms rendered at once, each with its own "
+        "-ahead frames of memory");
+DEFINE_int32(batch_cap, 0, "Render threads one batch zoom may have at once "
+        "unless it gives -cap, 0 for all of them");
+DEFINE_int32(batch_every, 100, "Write every this many frames of a batch zoom "
+        "unless it gives -every, the last frame is always written");
 
 const int THREADS  = 4;      //!< Concurrent threads to run
 const int SCR_CD   = 32;     //!< Bits of color
@@ -37,6 +143,84 @@ const int FRAMES   = 2000;   //!< Frames to render before quiting
 
 int64_t   SCR_WDTH = 0;      //!< Screen Width
 int64_t   SCR_HGHT = 0;      //!< Screen Height
+const int GUARD    = 24;     //!< Fraction bits kept below a pixel
+const int MARGIN   = 12;     //!< Spare bits auto asks of float
+
+/** Number types the escape time kernel can run in */
+enum kernelType{
+    KERNEL_AUTO,             //!< Picked per frame by pickKernel()
+    KERNEL_FLOAT,            //!< float, twice the lanes of double
+    KERNEL_DOUBLE,           //!< double
+    KERNEL_LD,               //!< long double, the original kernel
+    KERNEL_DD,               //!< double-double
+    KERNEL_QD,               //!< quad-double
+    KERNEL_FIXED             //!< wideFixed, limbs picked per frame
+};
+kernelType KERNEL  = KERNEL_AUTO;
+const char* KERNEL_NAMES[] = {"auto", "float", "double", "ld", "dd", "qd",
+    "fixed"};
+
+/** Instruction sets the kernels are built for, oldest first */
+enum isaLevel{
+    ISA_SSE2,                //!< Every x86-64
+    ISA_AVX2,                //!< AVX2 and FMA, Haswell on
+    ISA_AVX512               //!< AVX-512, Skylake-SP on
+};
+const char* ISA_NAMES[] = {"sse2", "avx2", "avx512"};
+
+/** Sets the kernels are built for, one iteration policy each */
+enum formulaType{
+    FORMULA_MANDELBROT,      //!< z^2 + c from z = 0
+    FORMULA_JULIA,           //!< z^2 + c for a fixed c, from z at the point
+    FORMULA_CUBIC,           //!< z^3 + c, the multibrot of power 3
+    FORMULA_QUARTIC,         //!< z^4 + c
+    FORMULA_SHIP             //!< The Burning Ship, (|x| + i|y|)^2 + c
+};
+formulaType FORMULA = FORMULA_MANDELBROT;
+//!< Power each formula raises z to
+const int   FORMULA_DEGREE[] = {2, 2, 3, 4, 2};
+long double JULIA_X = 0.0L;  //!< c for FORMULA_JULIA
+long double JULIA_Y = 0.0L;
+isaLevel   ISA     = ISA_SSE2;
+
+int64_t   TILES_X  = 0;      //!< Tiles across a frame
+int64_t   TILES_Y  = 0;      //!< Tiles down a frame
+
+std::vector<int> PIN_CPUS;   //!< CPU for each renderer, empty for any
+
+/** What a frame buffer holds, in turn: a frame's worth of counts,
+ * then with -aa the colour of each pixel that got extra samples, 0 for
+ * the rest, then with -smooth the |z|^2 each pixel escaped with as a
+ * float, 0 for those that never did, then with -distance each pixel's
+ * distance estimate in pixels as a float, 0 inside the set, then with
+ * -equalize how many pixels have each count up to MAX_ITER.
+ */
+enum framePlane{
+    PLANE_COUNTS,
+    PLANE_AA,
+    PLANE_SMOOTH,
+    PLANE_DIST,
+    PLANE_HIST,
+    PLANES
+};
+
+/** Where a plane starts in a frame buffer, or its end for PLANES */
+int64_t planeAt(framePlane p){
+    const int64_t px     = SCR_WDTH * SCR_HGHT;
+    const int64_t size[] = {px, FLAGS_aa > 1 ? px : 0, FLAGS_smooth ? px : 0,
+        FLAGS_distance ? px : 0, FLAGS_equalize ? MAX_ITER + 1 : 0};
+    int64_t       at = 0;
+    for(int k = 0; k < p; k++){
+        at += size[k];
+    }
+    return at;
+}
+
+/** Values in a frame buffer */
+int64_t framePixels(){
+    return planeAt(PLANES);
+}
+const uint64_t AA_SET = 1ULL << 24;   //!< Marks a colour in the -aa plane
 
 struct pixel{
     Uint8 r;                 //!< Red componet
@@ -52,6 +236,44 @@ struct pixel{
     }
 }colorTable[MAX_ITER];
 
+/** The path the zoom takes. Each frame removes the same fraction of the
+ * extent on both sides of the centre, so the extent of frame k is just
+ * the starting extent times (1 - zoom)^(k+1) and any frame can be had
+ * directly without stepping through the ones before it. Holds no
+ * state that changes while rendering so it can be copied into every
+ * thread or process freely. Everything is kept in full precision so
+ * deep frames are centred where the flags asked.
+ */
+struct zoomPath{
+    hpfloat orgX;              //!< Centre of the zoom
+    hpfloat orgY;
+    hpfloat halfX;             //!< Half the extent before the first frame
+    hpfloat halfY;
+    hpfloat shrink;            //!< Extent kept from one frame to the next
+
+    zoomPath(const hpfloat& ox, const hpfloat& oy, const hpfloat& dx,
+            const hpfloat& dy, const hpfloat& zoom){
+        orgX   = ox;
+        orgY   = oy;
+        halfX  = dx / 2;
+        halfY  = dy / 2;
+        shrink = 1 - zoom / 2;
+    }
+    //!< Fraction of the starting extent still visible in a frame
+    hpfloat scale(int64_t frame) const{
+        return pow(shrink, hpfloat(frame + 1));
+    }
+    //!< Bounds of the given frame, frame 0 is the first one drawn
+    void bounds(int64_t frame, long double* xmin, long double* xmax,
+            long double* ymin, long double* ymax) const{
+        hpfloat s = scale(frame);
+        fromHp(orgX - halfX * s, xmin);
+        fromHp(orgX + halfX * s, xmax);
+        fromHp(orgY - halfY * s, ymin);
+        fromHp(orgY + halfY * s, ymax);
+    }
+};
+
 struct rendThrData{
     static uint32_t   next_id; //!< Next thread id
     const uint32_t    id;      //!< That specific thread id
@@ -59,13 +281,30 @@ struct rendThrData{
     long double       xmax;
     long double       ymin;
     long double       ymax;
+    hpfloat           cx;      //!< Centre of the frame
+    hpfloat           cy;
+    long double       hx;      //!< Half the width of the frame
+    long double       hy;      //!< Half the height of the frame
+    int64_t           frame;   //!< Frame these bounds belong to
     uint64_t*         img;     //!< The image array
 
+    bool              owned;   //!< Whether img is given back with this
+
     rendThrData():id(next_id++){
-        img = new uint64_t[SCR_WDTH * SCR_HGHT];
+        img   = takeFrame(framePixels());
+        owned = true;
+        frame = -1;
+    }
+    //!< Renders into buffers that belong to something else
+    explicit rendThrData(uint64_t* buf):id(next_id++){
+        img   = buf;
+        owned = false;
+        frame = -1;
     }
     ~rendThrData(){
-        delete[] img;
+        if(owned){
+            giveFrame(img);
+        }
     }
     //!< Array write and access operator
     uint64_t& operator()(int64_t x, int64_t y){
@@ -84,8 +323,21 @@ inline long double map(long double x, long double in_min,
         (in_max - in_min) + out_min;
 }
 
+const int SMOOTH_STEPS = 16;  //!< Shades -smooth has from one count to the next
+const int SMOOTH_EXTRA = 4;   //!< Steps -smooth follows an orbit past escaping
+const int LOGLOG_BITS  = 5;   //!< Mantissa bits of |z|^2 indexing logLogTable
+const int LOGLOG_SIZE  = 125 << LOGLOG_BITS; //!< |z|^2 from 4 to FLT_MAX
+const int LOGLOG_SHIFT = FLT_MANT_DIG - 1 - LOGLOG_BITS;
+const int32_t LOGLOG_FOUR = 129 << (FLT_MANT_DIG - 1); //!< 4.0f's bits
+
+//!< The colour table with SMOOTH_STEPS shades between neighbours
+pixel smoothTable[MAX_ITER * SMOOTH_STEPS];
+//!< SMOOTH_EXTRA + 1 - log2(log2|z|) at each entry's |z|^2
+float logLogTable[LOGLOG_SIZE + 1];
+
 /**Initialize the color table with values for color coding images.
- * Makes abuse of overflow.
+ * Makes abuse of overflow. Also fills in the tables -smooth colours
+ * with.
 */
 void generateColorTable(){
     for(int i = 1; i < MAX_ITER; i++){
@@ -93,143 +345,2978 @@ void generateColorTable(){
         colorTable[i].g = i + 64 % i;
         colorTable[i].b = i + 96;
     }
+    for(int i = 0; i < MAX_ITER * SMOOTH_STEPS; i++){
+        const pixel& a = colorTable[i / SMOOTH_STEPS];
+        const pixel& b = colorTable[(i / SMOOTH_STEPS + 1) % MAX_ITER];
+        int          t = i % SMOOTH_STEPS;
+        smoothTable[i].r = (a.r * (SMOOTH_STEPS - t) + b.r * t) / SMOOTH_STEPS;
+        smoothTable[i].g = (a.g * (SMOOTH_STEPS - t) + b.g * t) / SMOOTH_STEPS;
+        smoothTable[i].b = (a.b * (SMOOTH_STEPS - t) + b.b * t) / SMOOTH_STEPS;
+    }
+    for(int i = 0; i <= LOGLOG_SIZE; i++){
+        int32_t bits = LOGLOG_FOUR + (i << LOGLOG_SHIFT);
+        float   r2;
+        memcpy(&r2, &bits, sizeof(r2));
+        logLogTable[i] = SMOOTH_EXTRA + 1.0 - log2(log2(r2) / 2.0) /
+            log2(FORMULA_DEGREE[FORMULA]);
+    }
 }
 
-void put_px(SDL_Surface* scr, int x, int y, pixel* p){
+/** The bits of a float, as the -smooth and -distance planes keep them */
+inline uint64_t escapeBits(float f){
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+/**\brief How far past its count a point is, from the |z|^2 its orbit
+ * had SMOOTH_EXTRA steps after escaping, out of logLogTable.
+ *
+ * Escaping with |z| of 2 leaves the colours a good half a count apart
+ * either side of the edge of a band, as c still counts for as much as z
+ * in the next step. SMOOTH_EXTRA steps on, |z| is far enough out for
+ * log2(log2|z|) to go up by one a step, so the count plus the fraction
+ * barely jumps from one band to the next. A formula of higher degree
+ * runs away that many times as fast, so its logs are to that base.
+ *
+ * The table is indexed on the exponent and top mantissa bits of |z|^2
+ * and the mantissa bits below those interpolate between two entries,
+ * which is good to a few parts in ten thousand with no logs taken per
+ * pixel.
+ */
+inline float escapeFraction(uint32_t bits){
+    int32_t k = (int32_t)(bits >> LOGLOG_SHIFT) - (LOGLOG_FOUR >> LOGLOG_SHIFT);
+    if(k < 0){
+        return logLogTable[0];
+    }else if(k >= LOGLOG_SIZE){
+        return logLogTable[LOGLOG_SIZE];
+    }
+    float t = (bits & ((1 << LOGLOG_SHIFT) - 1)) * (1.0f / (1 << LOGLOG_SHIFT));
+    return logLogTable[k] + t * (logLogTable[k + 1] - logLogTable[k]);
+}
+
+/**\brief The colour of a pixel for -smooth, from its count and the bits
+ * of the |z|^2 its orbit got to, as escapeLanes() gives them.
+ *
+ * The count plus escapeFraction() picks a shade out of smoothTable.
+ * Points that never escaped get colorTable's colour for them.
+ */
+inline const pixel& smoothColor(uint64_t n, uint64_t bits){
+    if(n >= MAX_ITER){
+        return colorTable[n % MAX_ITER];
+    }
+    int k = (n + escapeFraction(bits)) * SMOOTH_STEPS;
+    return smoothTable[(k < 0 ? 0 : k) % (MAX_ITER * SMOOTH_STEPS)];
+}
+
+/** For -distance, darkens an escaped pixel's colour in proportion to how
+ * far under a pixel from the boundary it is, by the bits of its
+ * distance estimate. The boundary comes out a line about a pixel wide
+ * however fine the filaments it runs along are.
+ */
+inline pixel shadeDistance(pixel p, uint64_t n, uint64_t bits){
+    uint32_t b = bits;
+    float    de;
+    memcpy(&de, &b, sizeof(de));
+    if(n < MAX_ITER && de < 1.0f){
+        p.r *= de;
+        p.g *= de;
+        p.b *= de;
+    }
+    return p;
+}
+
+/** The colour of a pixel from its count and the bits of what -smooth
+ * and -distance kept of it, whichever are on. -equalize colours are
+ * the drawer's to work out.
+ */
+inline pixel pixelColor(uint64_t n, uint64_t r2, uint64_t de){
+    pixel p = FLAGS_smooth ? smoothColor(n, r2) : colorTable[n % MAX_ITER];
+    return FLAGS_distance ? shadeDistance(p, n, de) : p;
+}
+
+void put_px(SDL_Surface* scr, int x, int y, const pixel* p){
     Uint32* p_screen = (Uint32*)scr->pixels;
     p_screen  += y * scr->w + x;
     *p_screen  = SDL_MapRGBA(scr->format, p->r, p->g, p->b,
             p->alpha);
 }
 
-/**\brief Calculates the mandelbrot value for a selected point on
- * the complex plane.
+/** How many lanes each kernel number type is iterated in and what type
+ * counts them. float gets twice the lanes of double since twice as many
+ * fit in a vector register, and 32 bit counts to match so they do too.
+ */
+template<class T>
+struct laneType{
+    static const int N = 8;
+    typedef uint64_t count;
+};
+
+template<>
+struct laneType<float>{
+    static const int N = 16;
+    typedef uint32_t count;
+};
+
+inline float sqr(float a){
+    return a * a;
+}
+
+inline double sqr(double a){
+    return a * a;
+}
+
+inline float twice(float a){
+    return a + a;
+}
+
+inline double twice(double a){
+    return a + a;
+}
+
+inline long double twice(long double a){
+    return a + a;
+}
+
+inline float absolute(float a){
+    return fabsf(a);
+}
+
+inline double absolute(double a){
+    return fabs(a);
+}
+
+inline long double absolute(long double a){
+    return fabsl(a);
+}
+
+/** Whether |z|^2 is still inside the escape radius */
+template<class T>
+inline bool inside(const T& r2){
+    return toDouble(r2) < 4.0;
+}
+
+inline bool inside(float r2){
+    return r2 < 4.0f;
+}
+
+inline bool inside(double r2){
+    return r2 < 4.0;
+}
+
+/** A kernel number rounded to double */
+template<class T>
+inline double asDouble(const T& a){
+    return toDouble(a);
+}
+
+inline double asDouble(float a){
+    return a;
+}
+
+inline double asDouble(double a){
+    return a;
+}
+
+/**\brief The iteration policy of the Mandelbrot set, which the other
+ * formulas build on.
+ *
+ * A policy is static functions the kernels are templated on, so each
+ * formula gets kernels of its own with its step inlined into them and
+ * nothing chosen per iteration. start() gives the first z and the c of
+ * the point x0, y0 and step() takes z on to the next one, handed x*x
+ * and y*y, which the escape test has worked out already. derive()
+ * steps the derivative the distance estimate is taken from, which
+ * starts at DZ0, given z before the step. DEGREE is the power z is
+ * raised to.
+ */
+struct mandelbrotSet{
+    static const int DEGREE = 2;
+    static const int DZ0    = 0;
+
+    template<class T>
+    static void start(const T& x0, const T& y0, T* x, T* y, T* cx, T* cy){
+        *x  = T(0.0);
+        *y  = T(0.0);
+        *cx = x0;
+        *cy = y0;
+    }
+    template<class T>
+    static void step(T* x, T* y, const T& xx, const T& yy, const T& cx,
+            const T& cy){
+        *y = twice(*x * *y) + cy;
+        *x = xx - yy + cx;
+    }
+    //!< dz/dc goes to 2 z dz/dc + 1
+    template<class U>
+    static void derive(U zx, U zy, U* dx, U* dy){
+        U t = 2 * (zx * *dx - zy * *dy) + 1;
+        *dy = 2 * (zx * *dy + zy * *dx);
+        *dx = t;
+    }
+};
+
+/** Julia sets: the Mandelbrot step with c fixed at JULIA_X, JULIA_Y
+ * and z starting at the point, so the derivative is dz/dz0.
+ */
+struct juliaSet : mandelbrotSet{
+    static const int DZ0 = 1;
+
+    template<class T>
+    static void start(const T& x0, const T& y0, T* x, T* y, T* cx, T* cy){
+        *x  = x0;
+        *y  = y0;
+        *cx = T(JULIA_X);
+        *cy = T(JULIA_Y);
+    }
+    //!< dz/dz0 goes to 2 z dz/dz0
+    template<class U>
+    static void derive(U zx, U zy, U* dx, U* dy){
+        U t = 2 * (zx * *dx - zy * *dy);
+        *dy = 2 * (zx * *dy + zy * *dx);
+        *dx = t;
+    }
+};
+
+/** Multibrot sets, z^D + c. z^D is z^2 from xx and yy multiplied by z
+ * D - 2 more times, which the compiler unrolls.
+ */
+template<int D>
+struct multibrotSet : mandelbrotSet{
+    static const int DEGREE = D;
+
+    template<class T>
+    static void step(T* x, T* y, const T& xx, const T& yy, const T& cx,
+            const T& cy){
+        T px = xx - yy;
+        T py = twice(*x * *y);
+        for(int k = 2; k < D; k++){
+            T t = px * *x - py * *y;
+            py  = px * *y + py * *x;
+            px  = t;
+        }
+        *x = px + cx;
+        *y = py + cy;
+    }
+    //!< dz/dc goes to D z^(D-1) dz/dc + 1
+    template<class U>
+    static void derive(U zx, U zy, U* dx, U* dy){
+        U px = zx, py = zy;
+        for(int k = 2; k < D; k++){
+            U t = px * zx - py * zy;
+            py  = px * zy + py * zx;
+            px  = t;
+        }
+        U t = D * (px * *dx - py * *dy) + 1;
+        *dy = D * (px * *dy + py * *dx);
+        *dx = t;
+    }
+};
+
+/** The Burning Ship, which folds z into the first quadrant before
+ * squaring it. Only 2xy changes, as x*x and y*y don't care.
+ */
+struct burningShip : mandelbrotSet{
+    template<class T>
+    static void step(T* x, T* y, const T& xx, const T& yy, const T& cx,
+            const T& cy){
+        *y = twice(absolute(*x * *y)) + cy;
+        *x = xx - yy + cx;
+    }
+    //!< The fold flips dz/dc with z, then it is squared along
+    template<class U>
+    static void derive(U zx, U zy, U* dx, U* dy){
+        *dx = zx < 0 ? -*dx : *dx;
+        *dy = zy < 0 ? -*dy : *dy;
+        mandelbrotSet::derive(absolute(zx), absolute(zy), dx, dy);
+    }
+};
+
+/**\brief Calculates the escape time of formula F for a selected point
+ * on the complex plane.
  * \param x0 The real part of the complex value
  * \param y0 THe imaginary part of the complex value
+ * \param r2 If not NULL, set to |z|^2 SMOOTH_EXTRA steps past where the
+ *           point escaped, 0 if it didn't
+ * \param de If not NULL, set to the distance estimate followEscaped()
+ *           describes, 0 if the point didn't escape
  * \return Number of iterations for convergence.
  */
-uint64_t mandelbrot(long double x0, long double y0){
+template<class F>
+uint64_t mandelbrot(long double x0, long double y0, float* r2 = NULL,
+        float* de = NULL){
     uint64_t   itr = 0;
-    long double x   = 0.0;
-    long double y   = 0.0;
+    long double x, y, cx, cy;
+    long double dx  = F::DZ0;  // dz/dc
+    long double dy  = 0.0;
+    F::start(x0, y0, &x, &y, &cx, &cy);
     while((x*x + y*y < 4.0) && (itr < MAX_ITER)){
-        long double xtmp = x*x - y*y + x0;
-        long double ytmp = 2*x*y + y0;
+        long double xtmp = x;
+        long double ytmp = y;
+        F::step(&xtmp, &ytmp, x*x, y*y, cx, cy);
         if((x == xtmp) && (y == ytmp)){
             itr = MAX_ITER;
             break;
         }
+        if(de){
+            F::derive(x, y, &dx, &dy);
+        }
         x = xtmp;
         y = ytmp;
         itr++;
     }
+    for(int i = 0; (r2 || de) && i < SMOOTH_EXTRA; i++){
+        F::derive(x, y, &dx, &dy);
+        F::step(&x, &y, x*x, y*y, cx, cy);
+    }
+    long double m = x*x + y*y;
+    if(r2){
+        *r2 = itr == MAX_ITER ? 0.0f : m < FLT_MAX ? (float)m : FLT_MAX;
+    }
+    if(de){
+        long double d = sqrtl(m) * logl(m) / sqrtl(dx*dx + dy*dy);
+        *de = itr == MAX_ITER || !(d == d) ? 0.0f : d < FLT_MAX ? (float)d :
+            FLT_MAX;
+    }
     return itr;
 }
 
-/** This is the "Main" function used for each
- * thread, and handling the drawing of the new
- * data for each thread.
+/** What escapeLanes() keeps of each orbit besides its count */
+enum laneKeep{
+    KEEP_COUNT = 0,
+    KEEP_R2    = 1,          //!< |z|^2 past escaping, for -smooth
+    KEEP_DIST  = 2           //!< Distance estimate, for -distance
+};
+
+/**\brief Follows N orbits SMOOTH_EXTRA steps on from where they escaped
+ * and works out what KEEP asks for from where they get to.
+ *
+ * Escaped orbits are on their way out and rounding no longer matters
+ * to them, so whatever number type they escaped in this is done in
+ * double, in straight line code that vectorizes. dz/dc is stepped on
+ * with them, which leaves the distance estimate 2|z|ln|z|/|dz/dc| as
+ * good as the one a far larger escape radius would give. The true
+ * distance to the set is between a quarter of it and all of it.
+ * \param x    z where each lane escaped, overwritten
+ * \param cx   c of each lane
+ * \param dx   dz/dc where each lane escaped, overwritten, with KEEP_DIST
+ * \param live Nonzero for lanes that never escaped, which get 0
+ * \param r2   With KEEP_R2, |z|^2 at the end
+ * \param de   With KEEP_DIST, the distance estimate
  */
-void* renderThread(void *data){
-    int itr = 0;
-    rendThrData* d = (rendThrData*)data;
-    for(int py = 0; py < SCR_HGHT; py++){
-        for(int px = 0; px < SCR_WDTH; px++){
-            long double x0 = map(px, 0, SCR_WDTH, d->xmin, d->xmax);
-            long double y0 = map(py, 0, SCR_HGHT, d->ymin, d->ymax);
-            (*d)(px, py) = mandelbrot(x0, y0);
+template<int N, int KEEP, class F, class count>
+inline void followEscaped(double* x, double* y, double* dx, double* dy,
+        const double* cx, const double* cy, const count* live, float* r2,
+        float* de){
+    for(int i = 0; i < SMOOTH_EXTRA; i++){
+        for(int l = 0; l < N; l++){
+            double xx = x[l] * x[l];
+            double yy = y[l] * y[l];
+            if(KEEP & KEEP_DIST){
+                F::derive(x[l], y[l], &dx[l], &dy[l]);
+            }
+            F::step(&x[l], &y[l], xx, yy, cx[l], cy[l]);
+        }
+    }
+    for(int l = 0; l < N; l++){
+        double m = x[l] * x[l] + y[l] * y[l];
+        if(KEEP & KEEP_R2){
+            r2[l] = live[l] ? 0.0f : m < FLT_MAX ? (float)m : FLT_MAX;
+        }
+        if(KEEP & KEEP_DIST){
+            // 2|z|ln|z| is sqrt(m) ln(m)
+            double d = sqrt(m) * log(m) / sqrt(dx[l] * dx[l] + dy[l] * dy[l]);
+            de[l] = live[l] || !(d == d) ? 0.0f : d < FLT_MAX ? (float)d :
+                FLT_MAX;
         }
     }
-    pthread_exit(NULL);
 }
 
-void setScale(rendThrData* d){
-    // define local macros for calculating delta
-#define dx (xmax-xmin)
-#define dy (ymax-ymin)
-    static uint64_t    count = 0; // times this function was called also an id
-    static long double xmin  = XMIN;
-    static long double xmax  = XMAX;
-    static long double ymin  = YMIN;
-    static long double ymax  = YMAX;
-    static long double zoom  = FLAGS_ZOOM / 2.0;
-    long double        xsca  = (dx*zoom)/2.0;
-    long double        ysca  = (dy*zoom)/2.0;
-    xmin += xsca;
-    xmax -= xsca;
-    ymin += ysca;
-    ymax -= ysca;
-    count++;
-    d->xmin = xmin;
-    d->xmax = xmax;
-    d->ymin = ymin;
-    d->ymax = ymax;
-    // Undefine local macros
-#undef dx
-#undef dy
+/**\brief The escape time kernel for a vector's worth of points at once
+ * in any of the kernel number types, iterating formula F.
+ *
+ * All lanes are stepped every iteration and a lane stops counting once
+ * it escapes, so the loop over lanes has no branches and vectorizes.
+ * A point stuck on a fixed point just counts up to MAX_ITER, which is
+ * what mandelbrot() returns for it as well. When KEEP asks for more
+ * than the count each lane also keeps the z it escaped with, a select
+ * more in the loop, and has it followed on by followEscaped(). For
+ * KEEP_DIST dz/dc is stepped along with z, in double whatever T is,
+ * since it only needs to be good relative to itself.
+ * \param x0  Real parts of the points
+ * \param y0  Imaginary parts of the points
+ * \param itr Number of iterations for each point
+ * \param r2  With KEEP_R2, |z|^2 SMOOTH_EXTRA steps past each escape
+ * \param de  With KEEP_DIST, distance estimate of each point
+ */
+template<class T, int KEEP, class F>
+void escapeLanes(const T* x0, const T* y0, uint64_t* itr, float* r2,
+        float* de){
+    typedef typename laneType<T>::count count;
+    const int N = laneType<T>::N;
+    T      x[N];
+    T      y[N];
+    T      cx[N];
+    T      cy[N];
+    count  live[N];
+    count  n[N];
+    T      ex[N];
+    T      ey[N];
+    double dx[N];            // dz/dc
+    double dy[N];
+    double edx[N];           // dz/dc where each lane escaped
+    double edy[N];
+    for(int l = 0; l < N; l++){
+        F::start(x0[l], y0[l], &x[l], &y[l], &cx[l], &cy[l]);
+        live[l] = 1;
+        n[l]    = 0;
+        ex[l]   = T(0.0);
+        ey[l]   = T(0.0);
+        dx[l]   = F::DZ0;
+        dy[l]   = 0.0;
+        edx[l]  = 0.0;
+        edy[l]  = 0.0;
+    }
+    for(int i = 0; i < MAX_ITER; i++){
+        count any = 0;
+        for(int l = 0; l < N; l++){
+            T     xx = sqr(x[l]);
+            T     yy = sqr(y[l]);
+            count in = inside(xx + yy);
+            if(KEEP){
+                ex[l] = live[l] > in ? x[l] : ex[l];
+                ey[l] = live[l] > in ? y[l] : ey[l];
+            }
+            if(KEEP & KEEP_DIST){
+                edx[l] = live[l] > in ? dx[l] : edx[l];
+                edy[l] = live[l] > in ? dy[l] : edy[l];
+                F::derive(asDouble(x[l]), asDouble(y[l]), &dx[l], &dy[l]);
+            }
+            live[l] &= in;
+            n[l]    += live[l];
+            any     |= live[l];
+            F::step(&x[l], &y[l], xx, yy, cx[l], cy[l]);
+        }
+        if(!any){
+            break;
+        }
+    }
+    for(int l = 0; l < N; l++){
+        itr[l] = n[l];
+    }
+    if(KEEP){
+        double zx[N], zy[N], dcx[N], dcy[N];
+        for(int l = 0; l < N; l++){
+            zx[l]  = asDouble(ex[l]);
+            zy[l]  = asDouble(ey[l]);
+            dcx[l] = asDouble(cx[l]);
+            dcy[l] = asDouble(cy[l]);
+        }
+        followEscaped<N, KEEP, F>(zx, zy, edx, edy, dcx, dcy, live, r2, de);
+    }
 }
 
-int main(int argc, char*argv[]){
-    pthread_t    thrds[THREADS];
-    rendThrData* data;
-    SDL_Surface* screen;
-    int i, rc, x, y;
-    
-    // Handle command line args
-    gflags::ParseCommandLineFlags(&argc, &argv, true);
-    assert(XMIN < XMAX);
-    assert(YMIN < YMAX);
-    SCR_WDTH = FLAGS_screen_width;
-    SCR_HGHT = ((double)SCR_WDTH / DX) * DY;
-    XMIN = static_cast<long double>(FLAGS_orgX) - DX / 2.0;
-    XMAX = static_cast<long double>(FLAGS_orgX) + DX / 2.0;
-    YMIN = static_cast<long double>(FLAGS_orgY) - DY / 2.0;
-    YMAX = static_cast<long double>(FLAGS_orgY) + DY / 2.0;
-    fprintf(stderr, "WND SZ = %d by %d\n", SCR_WDTH, SCR_HGHT);
+/** escapeLanes(), following the points on past escaping only when
+ * there is somewhere to put what that gives, the |z|^2 they get to or
+ * their distance estimate.
+ */
+template<class F, class T>
+inline void mandelbrotLanes(const T* x0, const T* y0, uint64_t* itr,
+        float* r2 = NULL, float* de = NULL){
+    if(r2 && de){
+        escapeLanes<T, KEEP_R2 | KEEP_DIST, F>(x0, y0, itr, r2, de);
+    }else if(r2){
+        escapeLanes<T, KEEP_R2, F>(x0, y0, itr, r2, de);
+    }else if(de){
+        escapeLanes<T, KEEP_DIST, F>(x0, y0, itr, r2, de);
+    }else{
+        escapeLanes<T, KEEP_COUNT, F>(x0, y0, itr, r2, de);
+    }
+}
 
-    SDL_Init(SDL_INIT_EVERYTHING); 
-    generateColorTable();
-    screen = SDL_SetVideoMode(SCR_WDTH, SCR_HGHT, SCR_CD, SDL_SWSURFACE);
-    data   = new rendThrData[THREADS];
-    // initialize threads
-    for(i = 0; i < THREADS; i++){
-        setScale(&data[i]);
-        rc = pthread_create(&thrds[i], NULL, renderThread, (void*)&data[i]);
-        if(rc){
-            fprintf(stderr, "Couldn't create thread: %d\n", rc);
+/** Works out the pixels covered by a tile. Tiles are numbered across
+ * then down.
+ */
+tileBox tileRect(int tile){
+    tileBox b;
+    b.left   = (tile % TILES_X) * FLAGS_tile;
+    b.top    = (tile / TILES_X) * FLAGS_tile;
+    b.right  = b.left + FLAGS_tile < SCR_WDTH ? b.left + FLAGS_tile : SCR_WDTH;
+    b.bottom = b.top + FLAGS_tile < SCR_HGHT ? b.top + FLAGS_tile : SCR_HGHT;
+    return b;
+}
+
+/** The tile a piece of a frame starts in */
+int tileOf(const tileBox& b){
+    return (b.top / FLAGS_tile) * TILES_X + b.left / FLAGS_tile;
+}
+
+/** Maps pixels to points in the number type T. Points are the centre,
+ * rounded from full precision to T, plus an offset added in T, so
+ * neighbouring pixels stay apart long after the bounds themselves run
+ * out of bits.
+ */
+template<class T>
+struct pixelCoords{
+    T           cx;
+    T           cy;
+    long double xstep;       //!< Width of a pixel
+    long double ystep;
+    long double hx;
+    long double hy;
+
+    //!< Not inlined into the renderTile() builds, it is all boost
+    __attribute__((noinline)) explicit pixelCoords(const rendThrData* d){
+        fromHp(d->cx, &cx);
+        fromHp(d->cy, &cy);
+        xstep = 2.0L * d->hx / SCR_WDTH;
+        ystep = 2.0L * d->hy / SCR_HGHT;
+        hx    = d->hx;
+        hy    = d->hy;
+    }
+    //!< Fractional pixels are points between them, for -aa
+    T x(long double px) const{
+        return cx + T(px * xstep - hx);
+    }
+    T y(long double py) const{
+        return cy + T(py * ystep - hy);
+    }
+};
+
+/** Renders a tile of formula F with mandelbrotLanes() in the number
+ * type T.
+ */
+template<class T, class F>
+void renderTileIn(rendThrData* d, const tileBox& b){
+    const int      N = laneType<T>::N;
+    const int      left = b.left, top = b.top, right = b.right;
+    const int      bottom = b.bottom;
+    T              x0[N];
+    T              y0[N];
+    uint64_t       itr[N];
+    float          r2[N];
+    float          de[N];
+    uint64_t*      esc  = d->img + planeAt(PLANE_SMOOTH);
+    uint64_t*      dist = d->img + planeAt(PLANE_DIST);
+    pixelCoords<T> c(d);
+    float          perPx = 1.0L / c.xstep;
+    for(int py = top; py < bottom; py++){
+        T y = c.y(py);
+        for(int px = left; px < right; px += N){
+            // Lanes past the right edge are computed and thrown away
+            for(int l = 0; l < N; l++){
+                x0[l] = c.x(px + l);
+                y0[l] = y;
+            }
+            mandelbrotLanes<F>(x0, y0, itr, FLAGS_smooth ? r2 : NULL,
+                    FLAGS_distance ? de : NULL);
+            for(int l = 0; l < N && px + l < right; l++){
+                (*d)(px + l, py) = itr[l];
+                if(FLAGS_smooth){
+                    esc[(px + l) * SCR_HGHT + py] = escapeBits(r2[l]);
+                }
+                if(FLAGS_distance){
+                    dist[(px + l) * SCR_HGHT + py] =
+                        escapeBits(de[l] * perPx);
+                }
+            }
         }
     }
-    for(i = 0; i < FRAMES; i++){
-        pthread_join(thrds[i % THREADS], NULL); // Join current thread
-        SDL_LockSurface(screen);
-        // Draw to the screen, a hack because SDL_Blit does not work right
-        for(x = 0; x < SCR_WDTH; x++){
-            for(y = 0; y < SCR_HGHT; y++){
-                // update pixel on screen for the data gotten from the
-                // thread workload that just ran
-                put_px(screen, x, y,
-                        &colorTable[data[i%THREADS](x, y)% MAX_ITER]);
+}
+
+/**\brief The float escape time kernel, which also keeps a running
+ * estimate of how far each float orbit may have drifted from the exact
+ * one.
+ *
+ * The drift grows by about 2|z| a step plus the rounding of the step
+ * itself. A lane whose escape test ever lands within the drift of the
+ * escape radius might have counted differently in double, so it is
+ * marked unsure and has to be redone. Elsewhere the counts are the
+ * ones double gives.
+ *
+ * The drift only grows like that for formulas of DEGREE 2. Folding z
+ * doesn't bring points apart, so the Burning Ship's does too. Starting
+ * from the point, a Julia set's orbit starts off by the rounding of it.
+ * \param sure    Set to 1 for lanes whose count can be trusted
+ * \param escaped With SMOOTH, |z|^2 as escapeLanes() gives it
+ */
+template<bool SMOOTH, class F>
+void escapeFloat(const float* x0, const float* y0, uint64_t* itr,
+        uint32_t* sure, float* escaped){
+    const int N = laneType<float>::N;
+    float     x[N];
+    float     y[N];
+    float     cx[N];
+    float     cy[N];
+    float     e[N];
+    uint32_t  live[N];
+    uint32_t  n[N];
+    float     ex[N];
+    float     ey[N];
+    for(int l = 0; l < N; l++){
+        F::start(x0[l], y0[l], &x[l], &y[l], &cx[l], &cy[l]);
+        e[l]    = FLT_EPSILON * (fabsf(x[l]) + fabsf(y[l]));
+        live[l] = 1;
+        n[l]    = 0;
+        sure[l] = 1;
+        ex[l]   = 0.0f;
+        ey[l]   = 0.0f;
+    }
+    for(int i = 0; i < MAX_ITER; i++){
+        uint32_t any = 0;
+        for(int l = 0; l < N; l++){
+            float xx = x[l] * x[l];
+            float yy = y[l] * y[l];
+            float r2 = xx + yy;
+            float m  = sqrtf(r2);    // |z|
+            sure[l] &= (live[l] ^ 1) |
+                (fabsf(r2 - 4.0f) > 2.0f * m * e[l] + 8.0f * FLT_EPSILON);
+            if(SMOOTH){
+                ex[l] = live[l] & (r2 >= 4.0f) ? x[l] : ex[l];
+                ey[l] = live[l] & (r2 >= 4.0f) ? y[l] : ey[l];
             }
+            live[l] &= r2 < 4.0f;
+            n[l]    += live[l];
+            any     |= live[l];
+            e[l]     = 2.0f * m * e[l] + e[l] * e[l] + 2.0f * FLT_EPSILON *
+                (r2 + fabsf(cx[l]) + fabsf(cy[l]));
+            F::step(&x[l], &y[l], xx, yy, cx[l], cy[l]);
         }
-        printf("Drew Frame %d\n", i);
-        SDL_UnlockSurface(screen);
-        if(SDL_Flip(screen) == -1){
-            fprintf(stderr, "SDL_Flip Failed");
-            return 1;
+        if(!any){
+            break;
         }
-        // Recreate the thread
-        setScale(&data[i%THREADS]); // update the scale data for that thread
-        rc = pthread_create(&thrds[i % THREADS], NULL, renderThread, 
-                (void*)&data[i % THREADS]); // spin up thread
-        // check if it was created successfully.
-        if(rc){
-            fprintf(stderr, "Couldn't create thread: %d\n", rc);
+    }
+    for(int l = 0; l < N; l++){
+        itr[l] = n[l];
+    }
+    if(SMOOTH){
+        double zx[N], zy[N], dcx[N], dcy[N];
+        for(int l = 0; l < N; l++){
+            zx[l]  = ex[l];
+            zy[l]  = ey[l];
+            dcx[l] = cx[l];
+            dcy[l] = cy[l];
         }
+        followEscaped<N, KEEP_R2, F>(zx, zy, NULL, NULL, dcx, dcy, live,
+                escaped, NULL);
     }
-    for(i = 0; i < THREADS; i++){
-        // Kill the remaining threads, let them rejoin the program.
-        pthread_join(thrds[i], NULL);
+}
+
+/** escapeFloat(), following escapes on only when r2 isn't NULL */
+template<class F>
+inline void mandelbrotFloat(const float* x0, const float* y0, uint64_t* itr,
+        uint32_t* sure, float* r2 = NULL){
+    if(r2){
+        escapeFloat<true, F>(x0, y0, itr, sure, r2);
+    }else{
+        escapeFloat<false, F>(x0, y0, itr, sure, r2);
     }
-    delete[] data;
-    SDL_Quit();
+}
+
+/** Renders a tile in float, then redoes the pixels float was unsure of
+ * in double, giving exactly what renderTileIn<double>() would.
+ */
+template<class F>
+void renderTileFloat(rendThrData* d, const tileBox& b){
+    const int           N = laneType<float>::N;
+    const int           M = laneType<double>::N;
+    const int           left = b.left, top = b.top, right = b.right;
+    const int           bottom = b.bottom;
+    float               x0[N];
+    float               y0[N];
+    uint64_t            itr[N];
+    uint32_t            sure[N];
+    float               r2[N];
+    double              dx0[M];
+    double              dy0[M];
+    uint64_t*           esc = d->img + planeAt(PLANE_SMOOTH);
+    float*              keep = FLAGS_smooth ? r2 : NULL;
+    // Pixels as px, py pairs, kept between tiles so its storage is too
+    static thread_local std::vector<int> redo;
+    pixelCoords<float>  c(d);
+    pixelCoords<double> cd(d);
+    redo.clear();
+    for(int py = top; py < bottom; py++){
+        float y = c.y(py);
+        for(int px = left; px < right; px += N){
+            for(int l = 0; l < N; l++){
+                x0[l] = c.x(px + l);
+                y0[l] = y;
+            }
+            mandelbrotFloat<F>(x0, y0, itr, sure, keep);
+            for(int l = 0; l < N && px + l < right; l++){
+                (*d)(px + l, py) = itr[l];
+                if(keep){
+                    esc[(px + l) * SCR_HGHT + py] = escapeBits(r2[l]);
+                }
+                if(!sure[l]){
+                    redo.push_back(px + l);
+                    redo.push_back(py);
+                }
+            }
+        }
+    }
+    for(size_t i = 0; i < redo.size(); i += 2 * M){
+        int n = (redo.size() - i) / 2 < (size_t)M ? (redo.size() - i) / 2 : M;
+        for(int l = 0; l < M; l++){
+            // Spare lanes repeat the first pixel
+            int k = l < n ? l : 0;
+            dx0[l] = cd.x(redo[i + 2 * k]);
+            dy0[l] = cd.y(redo[i + 2 * k + 1]);
+        }
+        mandelbrotLanes<F>(dx0, dy0, itr, keep);
+        for(int l = 0; l < n; l++){
+            (*d)(redo[i + 2 * l], redo[i + 2 * l + 1]) = itr[l];
+            if(keep){
+                esc[redo[i + 2 * l] * SCR_HGHT + redo[i + 2 * l + 1]] =
+                    escapeBits(r2[l]);
+            }
+        }
+    }
+}
+
+/** Fraction bits the fixed point kernels want for d's frame */
+int fixedBits(const rendThrData* d){
+    long double step = 2.0L * (d->hx < d->hy ? d->hx / SCR_WDTH :
+            d->hy / SCR_HGHT);
+    return GUARD - ilogbl(step);
+}
+
+/** Renders a tile in the narrowest wideFixed whose fraction still
+ * resolves a pixel with GUARD bits to spare for rounding to build up
+ * in. Past 256 bits it just does the best it can.
+ */
+template<class F>
+void renderTileFixed(rendThrData* d, const tileBox& b){
+    int bits = fixedBits(d);
+    if(bits <= wideFixed<2>::FRAC){
+        renderTileIn<wideFixed<2>, F>(d, b);
+    }else if(bits <= wideFixed<3>::FRAC){
+        renderTileIn<wideFixed<3>, F>(d, b);
+    }else{
+        renderTileIn<wideFixed<4>, F>(d, b);
+    }
+}
+
+/** Bits from the largest coordinate in d's frame down to a pixel */
+int frameBits(const rendThrData* d){
+    long double step = 2.0L * (d->hx < d->hy ? d->hx / SCR_WDTH :
+            d->hy / SCR_HGHT);
+    long double mag  = 2.0L;
+    long double cx, cy;
+    fromHp(d->cx, &cx);
+    fromHp(d->cy, &cy);
+    if(fabsl(cx) + d->hx > mag){
+        mag = fabsl(cx) + d->hx;
+    }
+    if(fabsl(cy) + d->hy > mag){
+        mag = fabsl(cy) + d->hy;
+    }
+    return ilogbl(mag) - ilogbl(step);
+}
+
+/** Whether wideFixed's 8 integer bits hold what -formula makes. An
+ * orbit leaves |z| < 2 at most at 2^D + 2, so |z|^2 reaches about 100
+ * for z^3 + c but over 300 for z^4 + c, which wraps around and tests
+ * as not escaped.
+ */
+inline bool fixedHolds(){
+    return FORMULA_DEGREE[FORMULA] <= 3;
+}
+
+/**\brief Picks the cheapest kernel that resolves a frame.
+ *
+ * A type will do when its mantissa covers the span from the largest
+ * coordinate in the frame down to a pixel, with bits to spare for
+ * rounding to build up in over the iterations. float redoes the pixels
+ * it is unsure of in double, so it gets by with MARGIN spare bits
+ * rather than GUARD, past which it would be redoing most of them.
+ */
+__attribute__((noinline)) kernelType pickKernel(const rendThrData* d){
+    int bits = frameBits(d);
+    if(bits + MARGIN <= FLT_MANT_DIG){
+        return KERNEL_FLOAT;
+    }else if(bits + GUARD <= DBL_MANT_DIG){
+        return KERNEL_DOUBLE;
+    }else if(bits + GUARD <= 2 * DBL_MANT_DIG){
+        return KERNEL_DD;
+    }
+    return fixedHolds() ? KERNEL_FIXED : KERNEL_QD;
+}
+
+/** Whether kernel k has the bits to resolve d's frame, judged the way
+ * pickKernel() judges it. auto always does, fixed never does when it
+ * can't hold the formula.
+ */
+bool resolves(kernelType k, const rendThrData* d){
+    static const int MANT[] = {0, FLT_MANT_DIG, DBL_MANT_DIG, LDBL_MANT_DIG,
+        2 * DBL_MANT_DIG, 4 * DBL_MANT_DIG, wideFixed<4>::FRAC};
+    int spare = k == KERNEL_FLOAT ? MARGIN : GUARD;
+    if(k == KERNEL_FIXED && !fixedHolds()){
+        return false;
+    }
+    return k == KERNEL_AUTO || frameBits(d) + spare <= MANT[k];
+}
+
+/** The kernel renderTile() uses for the frame d is scaled to */
+kernelType tileKernel(const rendThrData* d){
+    return KERNEL == KERNEL_AUTO ? pickKernel(d) : KERNEL;
+}
+
+/** Fills in the iteration counts of formula F for one tile of the
+ * frame d is scaled to, in whichever number type -kernel picked.
+ */
+template<class F>
+inline void renderTileAny(rendThrData* d, const tileBox& b){
+    switch(tileKernel(d)){
+    case KERNEL_FLOAT:
+        // Float's counts are double's, so -distance and formulas float
+        // can't bound the drift of just run in double
+        if(!FLAGS_distance && F::DEGREE == 2){
+            renderTileFloat<F>(d, b);
+            return;
+        }
+        renderTileIn<double, F>(d, b);
+        return;
+    case KERNEL_DOUBLE:
+        renderTileIn<double, F>(d, b);
+        return;
+    case KERNEL_DD:
+        renderTileIn<dd, F>(d, b);
+        return;
+    case KERNEL_QD:
+        renderTileIn<qd, F>(d, b);
+        return;
+    case KERNEL_FIXED:
+        renderTileFixed<F>(d, b);
+        return;
+    default:
+        break;
+    }
+    uint64_t* esc   = d->img + planeAt(PLANE_SMOOTH);
+    uint64_t* dist  = d->img + planeAt(PLANE_DIST);
+    float     perPx = SCR_WDTH / (d->xmax - d->xmin);
+    for(int py = b.top; py < b.bottom; py++){
+        for(int px = b.left; px < b.right; px++){
+            long double x0 = map(px, 0, SCR_WDTH, d->xmin, d->xmax);
+            long double y0 = map(py, 0, SCR_HGHT, d->ymin, d->ymax);
+            float       r2, de;
+            (*d)(px, py) = mandelbrot<F>(x0, y0, FLAGS_smooth ? &r2 : NULL,
+                    FLAGS_distance ? &de : NULL);
+            if(FLAGS_smooth){
+                esc[px * SCR_HGHT + py] = escapeBits(r2);
+            }
+            if(FLAGS_distance){
+                dist[px * SCR_HGHT + py] = escapeBits(de * perPx);
+            }
+        }
+    }
+}
+
+/** renderTileAny() built for each isaLevel. flatten inlines every
+ * kernel into these so the whole call tree is compiled for the level.
+ */
+template<class F>
+__attribute__((flatten))
+void renderTileSse2(rendThrData* d, const tileBox& b){
+    renderTileAny<F>(d, b);
+}
+
+template<class F>
+__attribute__((target("avx2,fma"), flatten))
+void renderTileAvx2(rendThrData* d, const tileBox& b){
+    renderTileAny<F>(d, b);
+}
+
+template<class F>
+__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma"),
+            flatten))
+void renderTileAvx512(rendThrData* d, const tileBox& b){
+    renderTileAny<F>(d, b);
+}
+
+typedef void (*tileFn)(rendThrData*, const tileBox&);
+//!< Each formulaType's renderTileAny() at each isaLevel
+const tileFn RENDER_TILE[][3] = {
+    {renderTileSse2<mandelbrotSet>, renderTileAvx2<mandelbrotSet>,
+        renderTileAvx512<mandelbrotSet>},
+    {renderTileSse2<juliaSet>, renderTileAvx2<juliaSet>,
+        renderTileAvx512<juliaSet>},
+    {renderTileSse2<multibrotSet<3> >, renderTileAvx2<multibrotSet<3> >,
+        renderTileAvx512<multibrotSet<3> >},
+    {renderTileSse2<multibrotSet<4> >, renderTileAvx2<multibrotSet<4> >,
+        renderTileAvx512<multibrotSet<4> >},
+    {renderTileSse2<burningShip>, renderTileAvx2<burningShip>,
+        renderTileAvx512<burningShip>}
+};
+
+/** Fills in one tile of FORMULA with the kernels built for ISA */
+void renderTile(rendThrData* d, const tileBox& b){
+    RENDER_TILE[FORMULA][ISA](d, b);
+}
+
+/** Iteration counts at n points given in pixels, which can fall between
+ * pixels, with mandelbrotLanes() in the number type T. What -smooth
+ * and -distance keep of each goes in r2 and de unless they are NULL,
+ * the distance in pixels.
+ */
+template<class T, class F>
+void samplesIn(const rendThrData* d, const double* sx, const double* sy,
+        int n, uint64_t* itr, float* r2, float* de){
+    const int      N = laneType<T>::N;
+    T              x0[N];
+    T              y0[N];
+    uint64_t       out[N];
+    float          esc[N];
+    float          dist[N];
+    pixelCoords<T> c(d);
+    for(int i = 0; i < n; i += N){
+        for(int l = 0; l < N; l++){
+            // Spare lanes repeat the first point
+            int k = i + l < n ? i + l : i;
+            x0[l] = c.x(sx[k]);
+            y0[l] = c.y(sy[k]);
+        }
+        mandelbrotLanes<F>(x0, y0, out, r2 ? esc : NULL, de ? dist : NULL);
+        for(int l = 0; l < N && i + l < n; l++){
+            itr[i + l] = out[l];
+            if(r2){
+                r2[i + l] = esc[l];
+            }
+            if(de){
+                de[i + l] = dist[l] / c.xstep;
+            }
+        }
+    }
+}
+
+/** Counts at n points in the kernel renderTileAny() would use for d's
+ * frame, so points on pixels get the counts the pixels got. float
+ * samples in double, which is what float comes out the same as.
+ */
+template<class F>
+inline void samplesAny(const rendThrData* d, const double* sx,
+        const double* sy, int n, uint64_t* itr, float* r2, float* de){
+    switch(tileKernel(d)){
+    case KERNEL_FLOAT:
+    case KERNEL_DOUBLE:
+        samplesIn<double, F>(d, sx, sy, n, itr, r2, de);
+        return;
+    case KERNEL_DD:
+        samplesIn<dd, F>(d, sx, sy, n, itr, r2, de);
+        return;
+    case KERNEL_QD:
+        samplesIn<qd, F>(d, sx, sy, n, itr, r2, de);
+        return;
+    case KERNEL_FIXED:
+        if(fixedBits(d) <= wideFixed<2>::FRAC){
+            samplesIn<wideFixed<2>, F>(d, sx, sy, n, itr, r2, de);
+        }else if(fixedBits(d) <= wideFixed<3>::FRAC){
+            samplesIn<wideFixed<3>, F>(d, sx, sy, n, itr, r2, de);
+        }else{
+            samplesIn<wideFixed<4>, F>(d, sx, sy, n, itr, r2, de);
+        }
+        return;
+    default:
+        break;
+    }
+    for(int i = 0; i < n; i++){
+        itr[i] = mandelbrot<F>(map(sx[i], 0, SCR_WDTH, d->xmin, d->xmax),
+                map(sy[i], 0, SCR_HGHT, d->ymin, d->ymax),
+                r2 ? &r2[i] : NULL, de ? &de[i] : NULL);
+        if(de){
+            de[i] *= SCR_WDTH / (d->xmax - d->xmin);
+        }
+    }
+}
+
+/** samplesAny() built for each isaLevel, like renderTileSse2() */
+template<class F>
+__attribute__((flatten))
+void samplesSse2(const rendThrData* d, const double* sx, const double* sy,
+        int n, uint64_t* itr, float* r2, float* de){
+    samplesAny<F>(d, sx, sy, n, itr, r2, de);
+}
+
+template<class F>
+__attribute__((target("avx2,fma"), flatten))
+void samplesAvx2(const rendThrData* d, const double* sx, const double* sy,
+        int n, uint64_t* itr, float* r2, float* de){
+    samplesAny<F>(d, sx, sy, n, itr, r2, de);
+}
+
+template<class F>
+__attribute__((target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma"),
+            flatten))
+void samplesAvx512(const rendThrData* d, const double* sx, const double* sy,
+        int n, uint64_t* itr, float* r2, float* de){
+    samplesAny<F>(d, sx, sy, n, itr, r2, de);
+}
+
+typedef void (*samplesFn)(const rendThrData*, const double*, const double*,
+        int, uint64_t*, float*, float*);
+//!< Laid out like RENDER_TILE
+const samplesFn SAMPLES[][3] = {
+    {samplesSse2<mandelbrotSet>, samplesAvx2<mandelbrotSet>,
+        samplesAvx512<mandelbrotSet>},
+    {samplesSse2<juliaSet>, samplesAvx2<juliaSet>,
+        samplesAvx512<juliaSet>},
+    {samplesSse2<multibrotSet<3> >, samplesAvx2<multibrotSet<3> >,
+        samplesAvx512<multibrotSet<3> >},
+    {samplesSse2<multibrotSet<4> >, samplesAvx2<multibrotSet<4> >,
+        samplesAvx512<multibrotSet<4> >},
+    {samplesSse2<burningShip>, samplesAvx2<burningShip>,
+        samplesAvx512<burningShip>}
+};
+
+/** A repeatable offset in [0, 1) for sample k of a pixel, so a frame
+ * comes out the same whichever renderer samples it.
+ */
+double jitter(int64_t frame, int px, int py, int k){
+    uint64_t h = (uint64_t)frame * 0x9e3779b97f4a7c15ULL ^
+        ((uint64_t)px << 40) ^ ((uint64_t)py << 20) ^ (uint64_t)k;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3f99e3779b9ULL;
+    h ^= h >> 33;
+    return (h >> 11) * (1.0 / (1ULL << 53));
+}
+
+/**\brief Adds -aa samples to the pixels of a rendered tile that sit on
+ * an edge, writing their colours after the counts.
+ *
+ * A pixel is on an edge when its count is more than -aa_threshold from
+ * one of its four neighbours'. Neighbours outside the tile belong to
+ * other renderers, so they are sampled here rather than waited for. An
+ * edge pixel is split into aa by aa cells with a jittered sample in
+ * each, its own count standing in for the first cell's, and gets the
+ * mean of their colours, smooth ones with -smooth. Every other pixel of
+ * the tile gets 0, for colorFrame() to colour it as before.
+ */
+void antialiasTile(rendThrData* d, const tileBox& b){
+    static thread_local std::vector<double>   sx, sy;
+    static thread_local std::vector<uint64_t> itr;
+    static thread_local std::vector<float>    r2, de;
+    static thread_local std::vector<int64_t>  around;
+    const int n = FLAGS_aa;
+    const int w = b.right - b.left + 2;      // the tile and a pixel round it
+    const int h = b.bottom - b.top + 2;
+    uint64_t* colour = d->img + planeAt(PLANE_AA);
+    uint64_t* esc    = d->img + planeAt(PLANE_SMOOTH);
+    uint64_t* dist   = d->img + planeAt(PLANE_DIST);
+    around.assign(w * h, -1);
+    sx.clear();
+    sy.clear();
+    for(int x = b.left - 1; x <= b.right; x++){
+        for(int y = b.top - 1; y <= b.bottom; y++){
+            if(x < 0 || y < 0 || x >= SCR_WDTH || y >= SCR_HGHT){
+                continue;
+            }
+            if(x >= b.left && x < b.right && y >= b.top && y < b.bottom){
+                around[(x - b.left + 1) * h + y - b.top + 1] = (*d)(x, y);
+            }else{
+                sx.push_back(x);
+                sy.push_back(y);
+            }
+        }
+    }
+    itr.resize(sx.size());
+    SAMPLES[FORMULA][ISA](d, sx.data(), sy.data(), sx.size(), itr.data(), NULL,
+            NULL);
+    for(size_t i = 0; i < sx.size(); i++){
+        around[((int)sx[i] - b.left + 1) * h + (int)sy[i] - b.top + 1] =
+            itr[i];
+    }
+    // Edge pixels, then their samples, n * n - 1 to a pixel
+    sx.clear();
+    sy.clear();
+    for(int x = b.left; x < b.right; x++){
+        for(int y = b.top; y < b.bottom; y++){
+            const int64_t* a = &around[(x - b.left + 1) * h + y - b.top + 1];
+            int64_t        c = *a;
+            bool           edge = FLAGS_aa_threshold < 0;
+            int64_t        nb[4] = {a[-h], a[h], a[-1], a[1]};
+            if(FLAGS_distance && c < MAX_ITER){
+                // The boundary is within a pixel of escaped pixels
+                uint32_t bits = dist[x * SCR_HGHT + y];
+                float    near;
+                memcpy(&near, &bits, sizeof(near));
+                edge = edge || near < 1.0f;
+            }
+            for(int k = 0; k < 4 && !edge; k++){
+                if(FLAGS_distance){
+                    // and runs between the set and escaped neighbours
+                    edge = c >= MAX_ITER && nb[k] >= 0 && nb[k] < MAX_ITER;
+                }else{
+                    edge = nb[k] >= 0 &&
+                        llabs(nb[k] - c) > FLAGS_aa_threshold;
+                }
+            }
+            colour[x * SCR_HGHT + y] = 0;
+            if(!edge){
+                continue;
+            }
+            sx.push_back(x);
+            sy.push_back(y);
+        }
+    }
+    size_t edges = sx.size();
+    for(size_t e = 0; e < edges; e++){
+        int px = sx[e], py = sy[e];
+        for(int k = 1; k < n * n; k++){
+            sx.push_back(px + (k % n + jitter(d->frame, px, py, 2 * k)) / n);
+            sy.push_back(py + (k / n + jitter(d->frame, px, py, 2 * k + 1)) /
+                    n);
+        }
+    }
+    itr.resize(sx.size() - edges);
+    r2.resize(FLAGS_smooth ? itr.size() : 0);
+    de.resize(FLAGS_distance ? itr.size() : 0);
+    SAMPLES[FORMULA][ISA](d, sx.data() + edges, sy.data() + edges, itr.size(),
+            itr.data(), FLAGS_smooth ? r2.data() : NULL,
+            FLAGS_distance ? de.data() : NULL);
+    for(size_t e = 0; e < edges; e++){
+        int      px = sx[e], py = sy[e];
+        uint32_t r, g, bl;
+        int64_t  at  = px * SCR_HGHT + py;
+        pixel    own = pixelColor(d->img[at], FLAGS_smooth ? esc[at] : 0,
+                FLAGS_distance ? dist[at] : 0);
+        r  = own.r;
+        g  = own.g;
+        bl = own.b;
+        for(int k = 1; k < n * n; k++){
+            size_t i = e * (n * n - 1) + k - 1;
+            pixel  p = pixelColor(itr[i],
+                    FLAGS_smooth ? escapeBits(r2[i]) : 0,
+                    FLAGS_distance ? escapeBits(de[i]) : 0);
+            r  += p.r;
+            g  += p.g;
+            bl += p.b;
+        }
+        colour[px * SCR_HGHT + py] = AA_SET | (r / (n * n)) << 16 |
+            (g / (n * n)) << 8 | bl / (n * n);
+    }
+}
+
+/**\brief Fills in a tile's counts for -boundary, iterating only the
+ * pixels along the edges between bands of one count.
+ *
+ * The tile's border and a -boundary_grid of pixels inside it are
+ * counted first. Wherever two counted neighbours differ there is an
+ * edge, and the eight pixels round both are counted, which reaches the
+ * pair at the next bend of the edge, so each edge is followed to its
+ * end. Pixels are counted a wave at a time, every pixel queued by the
+ * last wave at once, to keep the kernel's lanes full. Everything not
+ * counted takes the count to its left, the border having counted the
+ * first column. Two neighbours that then disagree, one of them filled,
+ * are on an edge the waves never reached, like a band only a grid pixel
+ * fell in. The filled pixels from each back to the counted one it was
+ * filled from are counted, which puts counted pixels either side of
+ * the edge somewhere along them, and the waves and the fill run again.
+ *
+ * So every edge the waves reach has counted pixels either side of it
+ * all the way along. What they can't reach is a band lying wholly
+ * between the counted pixels: a closed edge that neither the border, a
+ * grid pixel nor another edge touches. Only with a grid of 1, where
+ * every pixel is counted, are the counts always the ones renderTile()
+ * gives. A coarser grid makes -boundary a preview that can lose bands
+ * smaller than the grid.
+ */
+void traceTile(rendThrData* d, const tileBox& b){
+    // OUTSIDE rings the tile, so neighbours never need bounds checks
+    enum{UNSEEN, QUEUED, COUNTED, OUTSIDE};
+    static thread_local std::vector<uint8_t>  state;
+    static thread_local std::vector<uint64_t> cnt;
+    static thread_local std::vector<int>      wave, next;
+    static thread_local std::vector<double>   sx, sy;
+    static thread_local std::vector<uint64_t> itr;
+    const int w = b.right - b.left;
+    const int h = b.bottom - b.top;
+    const int H = h + 2;                     // down a column of the ring
+    const int g = FLAGS_boundary_grid;
+    const int side[4]   = {-H, H, -1, 1};
+    const int around[8] = {-H - 1, -H, -H + 1, -1, 1, H - 1, H, H + 1};
+    state.assign((w + 2) * H, OUTSIDE);
+    cnt.resize((w + 2) * H);
+    wave.clear();
+    for(int x = 0; x < w; x++){
+        for(int y = 0; y < h; y++){
+            int k = (x + 1) * H + y + 1;
+            state[k] = UNSEEN;
+            if(x == 0 || y == 0 || x == w - 1 || y == h - 1 || (g > 0 &&
+                        (b.left + x) % g == 0 && (b.top + y) % g == 0)){
+                state[k] = QUEUED;
+                wave.push_back(k);
+            }
+        }
+    }
+    while(!wave.empty()){
+        while(!wave.empty()){
+            sx.clear();
+            sy.clear();
+            for(size_t i = 0; i < wave.size(); i++){
+                sx.push_back(b.left + wave[i] / H - 1);
+                sy.push_back(b.top + wave[i] % H - 1);
+            }
+            itr.resize(wave.size());
+            SAMPLES[FORMULA][ISA](d, sx.data(), sy.data(), wave.size(),
+                    itr.data(), NULL, NULL);
+            for(size_t i = 0; i < wave.size(); i++){
+                cnt[wave[i]]   = itr[i];
+                state[wave[i]] = COUNTED;
+            }
+            next.clear();
+            for(size_t i = 0; i < wave.size(); i++){
+                int k = wave[i];
+                for(int n = 0; n < 4; n++){
+                    int j = k + side[n];
+                    if(state[j] != COUNTED || cnt[j] == cnt[k]){
+                        continue;
+                    }
+                    // Queue the pixels round both sides of the edge
+                    for(int a = 0; a < 8; a++){
+                        if(state[k + around[a]] == UNSEEN){
+                            state[k + around[a]] = QUEUED;
+                            next.push_back(k + around[a]);
+                        }
+                        if(state[j + around[a]] == UNSEEN){
+                            state[j + around[a]] = QUEUED;
+                            next.push_back(j + around[a]);
+                        }
+                    }
+                }
+            }
+            wave.swap(next);
+        }
+        for(int k = 2 * H; k < (w + 1) * H; k++){
+            if(state[k] == UNSEEN){
+                cnt[k] = cnt[k - H];
+            }
+        }
+        for(int k = H; k < (w + 1) * H; k++){
+            for(int n = 1; n < 4; n += 2){
+                int j = k + side[n];
+                if(state[k] == OUTSIDE || state[j] == OUTSIDE ||
+                        cnt[j] == cnt[k]){
+                    continue;
+                }
+                // Count the filled pixels back along each row
+                for(int f = k; state[f] == UNSEEN; f -= H){
+                    state[f] = QUEUED;
+                    wave.push_back(f);
+                }
+                for(int f = j; state[f] == UNSEEN; f -= H){
+                    state[f] = QUEUED;
+                    wave.push_back(f);
+                }
+            }
+        }
+    }
+    for(int x = 0; x < w; x++){
+        memcpy(d->img + (b.left + x) * SCR_HGHT + b.top,
+                &cnt[(x + 1) * H + 1], h * sizeof(uint64_t));
+    }
+}
+
+/** The best isaLevel this CPU can run, asked of CPUID once. */
+isaLevel isaSupported(){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512bw") &&
+            __builtin_cpu_supports("avx512dq") &&
+            __builtin_cpu_supports("avx512vl")){
+        return ISA_AVX512;
+    }else if(__builtin_cpu_supports("avx2") &&
+            __builtin_cpu_supports("fma")){
+        return ISA_AVX2;
+    }
+    return ISA_SSE2;
+}
+
+/** Adds up the iteration counts of a rendered tile. */
+uint64_t tileIterations(rendThrData* d, const tileBox& b){
+    uint64_t itr = 0;
+    for(int px = b.left; px < b.right; px++){
+        for(int py = b.top; py < b.bottom; py++){
+            itr += (*d)(px, py);
+        }
+    }
+    return itr;
+}
+
+/**\brief Adds a rendered tile's counts to its frame's -equalize
+ * histogram.
+ *
+ * The tile is counted into a histogram of the renderer's own first, and
+ * only the counts it has are added to the frame's, with atomic adds
+ * that work between -shm processes as well as threads. A tile has a few
+ * dozen different counts in it, so renderers sharing a frame hardly
+ * ever touch its histogram, where counting straight into it would have
+ * them fighting over its cache lines for every pixel.
+ */
+void histogramTile(rendThrData* d, const tileBox& b){
+    static thread_local std::vector<uint32_t> own(MAX_ITER + 1);
+    uint64_t* hist = d->img + planeAt(PLANE_HIST);
+    for(int px = b.left; px < b.right; px++){
+        const uint64_t* col = d->img + px * SCR_HGHT;
+        for(int py = b.top; py < b.bottom; py++){
+            own[col[py]]++;
+        }
+    }
+    for(int k = 0; k <= MAX_ITER; k++){
+        if(own[k]){
+            __atomic_fetch_add(&hist[k], own[k], __ATOMIC_RELAXED);
+            own[k] = 0;
+        }
+    }
+}
+
+/** Fills in the iteration counts for the frame d is scaled to. */
+void renderFrame(rendThrData* d){
+    for(int t = 0; t < TILES_X * TILES_Y; t++){
+        if(FLAGS_boundary){
+            traceTile(d, tileRect(t));
+        }else{
+            renderTile(d, tileRect(t));
+        }
+    }
+}
+
+/** Points a thread's workload at a frame of the zoom. */
+void setScale(const zoomPath& z, int64_t frame, rendThrData* d){
+    hpfloat s = z.scale(frame);
+    d->frame = frame;
+    d->cx    = z.orgX;
+    d->cy    = z.orgY;
+    fromHp(z.halfX * s, &d->hx);
+    fromHp(z.halfY * s, &d->hy);
+    z.bounds(frame, &d->xmin, &d->xmax, &d->ymin, &d->ymax);
+}
+
+/** Pins renderer worker, a process or the calling thread if who is 0,
+ * to its CPU from -affinity.
+ */
+void pinWorker(pid_t who, int worker){
+    if(!PIN_CPUS.empty()){
+        pinTo(who, PIN_CPUS[worker % PIN_CPUS.size()]);
+    }
+}
+
+/** What a render thread needs to pull frames off the ring. */
+struct ringWork{
+    frameRing*      ring;
+    tilePlanner*    plan;    //!< Which piece of a frame each claim is
+    const zoomPath* path;
+    tileCosts*      costs;   //!< Where tile costs go, NULL for nowhere
+    int             worker;  //!< This renderer's number
+};
+
+/** Renders a piece of the frame d is scaled to, with everything the
+ * flags ask for on top of the counts.
+ */
+void renderPiece(rendThrData* d, const tileBox& b){
+    if(FLAGS_boundary){
+        traceTile(d, b);
+    }else{
+        renderTile(d, b);
+    }
+    if(FLAGS_aa > 1){
+        antialiasTile(d, b);
+    }
+    if(FLAGS_equalize){
+        histogramTile(d, b);
+    }
+}
+
+/** Renders pieces of frames straight into the ring until they run out.
+ * Pieces are handed out in frame order, so up to -ahead frames can have
+ * pieces in flight at once no matter how many threads there are. Claims
+ * past the end of a frame's plan are finished without rendering
+ * anything. Used by the render threads and by -shm worker processes
+ * alike.
+ */
+void renderRing(const ringWork* w){
+    frameRing*  ring = w->ring;
+    rendThrData d(NULL);
+    int64_t     f;
+    int         t;
+    tileBox     b;
+    perfThread  counters(FLAGS_perf, FLAGS_perf_fp_assist);
+    perfCounts  before = {{0}};
+    perfCounts  after  = {{0}};
+    while(ring->claim(&f, &t)){
+        uint64_t start = traceNow();
+        d.img = ring->acquire(f);
+        traceEnd(PHASE_ACQUIRE, start, f, t);
+        if(!d.img){
+            return;
+        }
+        if(!w->plan->piece(f, t, &b)){
+            ring->finish(f);
+            continue;
+        }
+        traceScope span(PHASE_RENDER, f, t);
+        uint64_t   began = w->costs ? costNow() : 0;
+        if(d.frame != f){
+            setScale(*w->path, f, &d);
+        }
+        counters.read(&before);
+        renderPiece(&d, b);
+        if(w->costs){
+            w->costs->record(f, t, w->worker, b, began, costNow(),
+                    tileIterations(&d, b));
+        }
+        if(FLAGS_perf){
+            counters.read(&after);
+            perfAdd(tileKernel(&d), tileOf(b), before, after,
+                    (b.right - b.left) * (b.bottom - b.top),
+                    tileIterations(&d, b));
+        }
+        w->plan->record(f, b, d.img);
+        ring->finish(f);
+    }
+}
+
+/** This is the "Main" function used for each
+ * thread, it keeps rendering whichever frame is next
+ * until the zoom is finished.
+ */
+void* renderThread(void *data){
+    const ringWork* w = (ringWork*)data;
+    // Pinned before it allocates anything, so that lands on its node
+    pinWorker(0, w->worker);
+    traceThread("render");
+    renderRing(w);
+    pthread_exit(NULL);
+}
+
+/** Renders a frame inside a shard worker process, ctx is the zoomPath.
+ * Each worker renders one frame at a time so a single buffer does.
+ */
+const uint64_t* renderShard(void* ctx, int64_t frame){
+    static rendThrData d;
+    traceScope         span(PHASE_RENDER, frame);
+    setScale(*(const zoomPath*)ctx, frame, &d);
+    renderFrame(&d);
+    for(int t = 0; FLAGS_aa > 1 && t < TILES_X * TILES_Y; t++){
+        antialiasTile(&d, tileRect(t));
+    }
+    if(FLAGS_equalize){
+        memset(d.img + planeAt(PLANE_HIST), 0,
+                (MAX_ITER + 1) * sizeof(uint64_t));
+        for(int t = 0; t < TILES_X * TILES_Y; t++){
+            histogramTile(&d, tileRect(t));
+        }
+    }
+    return d.img;
+}
+
+/** The view flags as the checkpoint records them */
+std::string viewLine(){
+    char w[16];
+    snprintf(w, sizeof(w), "%d", FLAGS_screen_width);
+    return "view " + FLAGS_orgX + " " + FLAGS_orgY + " " + FLAGS_DX + " " +
+        FLAGS_DY + " " + FLAGS_ZOOM + " " + w;
+}
+
+/**\brief Writes the last completed frame to the checkpoint file.
+ *
+ * The file is written beside the real one and then renamed over it, so
+ * a crash part way through leaves the previous checkpoint intact. The
+ * zoom path is rebuilt from the flags on resume, so they are stored,
+ * exactly as given, to refuse a resume with a different view.
+ * \return true on success
+ */
+bool saveCheckpoint(const char* path, int64_t frame){
+    char  tmp[4096];
+    FILE* fp;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if(!fp){
+        return false;
+    }
+    fprintf(fp, "mandelbrot-checkpoint 3\n");
+    fprintf(fp, "frame %lld\n", (long long)frame);
+    fprintf(fp, "%s\n", viewLine().c_str());
+    if(fflush(fp) != 0 || fsync(fileno(fp)) != 0){
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+    return rename(tmp, path) == 0;
+}
+
+/**\brief Reads back a checkpoint written by saveCheckpoint().
+ * \param frame Set to the last completed frame
+ * \return true if the file was read and matches the current flags
+ */
+bool loadCheckpoint(const char* path, int64_t* frame){
+    FILE*     fp;
+    int       ver;
+    long long f;
+    char      view[8192];
+    bool      ok;
+    fp = fopen(path, "r");
+    if(!fp){
+        fprintf(stderr, "Couldn't open checkpoint %s\n", path);
+        return false;
+    }
+    ok = fscanf(fp, "mandelbrot-checkpoint %d ", &ver) == 1 && ver == 3 &&
+         fscanf(fp, "frame %lld ", &f) == 1 &&
+         fgets(view, sizeof(view), fp) != NULL;
+    fclose(fp);
+    if(!ok){
+        fprintf(stderr, "Checkpoint %s is malformed\n", path);
+        return false;
+    }
+    view[strcspn(view, "\n")] = '\0';
+    if(viewLine() != view){
+        fprintf(stderr, "Checkpoint %s was made with a different view\n",
+                path);
+        return false;
+    }
+    *frame = f;
+    return true;
+}
+
+/**\brief For -equalize, where each count falls in a frame's histogram
+ * of counts, out of the histogram its renderers left in it.
+ *
+ * cdf[n] is the fraction of the pixels that escaped with a count below
+ * n, so counts few pixels have take up little of the palette and
+ * crowded ones a lot. equal[n] is the colour for count n, from the one
+ * end of colorTable to the other as cdf[n + 1] goes from 0 to 1.
+ * Pixels that never escaped stay black.
+ */
+void equalizeFrame(const uint64_t* img, float* cdf, pixel* equal){
+    const uint64_t* hist = img + planeAt(PLANE_HIST);
+    uint64_t        escaped = 0;
+    uint64_t        below   = 0;
+    for(int k = 0; k < MAX_ITER; k++){
+        escaped += hist[k];
+    }
+    for(int k = 0; k <= MAX_ITER; k++){
+        cdf[k] = escaped ? (double)below / escaped : 0.0;
+        below += k < MAX_ITER ? hist[k] : 0;
+    }
+    for(int k = 0; k < MAX_ITER; k++){
+        equal[k] = colorTable[1 + (int)(cdf[k + 1] * (MAX_ITER - 2))];
+    }
+    equal[MAX_ITER] = colorTable[0];
+}
+
+/** The colour of a pixel for -smooth with -equalize. The continuous
+ * count is placed between the cdf of the counts either side of it, so
+ * the shades run on smoothly from one count to the next.
+ */
+inline const pixel& equalColor(uint64_t n, uint64_t bits, const float* cdf){
+    if(n >= MAX_ITER){
+        return colorTable[0];
+    }
+    float nu = n + escapeFraction(bits);
+    int   k  = nu < 0.0f ? 0 : nu < MAX_ITER - 1 ? (int)nu : MAX_ITER - 1;
+    float p  = cdf[k] + (nu - k) * (cdf[k + 1] - cdf[k]);
+    p = p < 0.0f ? 0.0f : p > 1.0f ? 1.0f : p;
+    return smoothTable[SMOOTH_STEPS + (int)(p * (MAX_ITER - 2) *
+            SMOOTH_STEPS)];
+}
+
+/** Colours a frame's iteration counts into a surface. */
+void colorFrame(SDL_Surface* screen, const uint64_t* img){
+    int x, y;
+    const uint64_t* esc  = img + planeAt(PLANE_SMOOTH);
+    const uint64_t* dist = img + planeAt(PLANE_DIST);
+    float           cdf[MAX_ITER + 1];
+    pixel           equal[MAX_ITER + 1];
+    if(FLAGS_equalize){
+        equalizeFrame(img, cdf, equal);
+    }
+    SDL_LockSurface(screen);
+    // Draw to the screen, a hack because SDL_Blit does not work right
+    for(x = 0; x < SCR_WDTH; x++){
+        for(y = 0; y < SCR_HGHT; y++){
+            // update pixel on screen for the data gotten from the
+            // thread workload that just ran
+            int64_t      k = x * SCR_HGHT + y;
+            const pixel* p = &colorTable[img[k] % MAX_ITER];
+            if(FLAGS_equalize && FLAGS_smooth){
+                p = &equalColor(img[k], esc[k], cdf);
+            }else if(FLAGS_equalize){
+                p = &equal[img[k]];
+            }else if(FLAGS_smooth){
+                p = &smoothColor(img[k], esc[k]);
+            }
+            if(FLAGS_distance){
+                pixel q = shadeDistance(*p, img[k], dist[k]);
+                put_px(screen, x, y, &q);
+                continue;
+            }
+            put_px(screen, x, y, p);
+        }
+    }
+    // -aa pixels have their colour worked out already
+    const uint64_t* aa = img + planeAt(PLANE_AA);
+    for(int64_t k = 0; FLAGS_aa > 1 && k < SCR_WDTH * SCR_HGHT; k++){
+        uint64_t c = aa[k];
+        pixel    p;
+        if(c & AA_SET){
+            p.r = c >> 16;
+            p.g = c >> 8;
+            p.b = c;
+            put_px(screen, k / SCR_HGHT, k % SCR_HGHT, &p);
+        }
+    }
+    SDL_UnlockSurface(screen);
+}
+
+/** Colours a frame of iteration counts onto the screen and records it
+ * in the checkpoint.
+ * \return false if the screen could not be updated
+ */
+bool drawFrame(SDL_Surface* screen, const uint64_t* img, int frame){
+    uint64_t start = traceNow();
+    colorFrame(screen, img);
+    traceEnd(PHASE_COLOR, start, frame);
+    printf("Drew Frame %d\n", frame);
+    start = traceNow();
+    if(SDL_Flip(screen) == -1){
+        fprintf(stderr, "SDL_Flip Failed");
+        return false;
+    }
+    traceEnd(PHASE_FLIP, start, frame);
+    traceScope span(PHASE_CHECKPOINT, frame);
+    if(!FLAGS_checkpoint.empty() &&
+            !saveCheckpoint(FLAGS_checkpoint.c_str(), frame)){
+        fprintf(stderr, "Couldn't write checkpoint %s\n",
+                FLAGS_checkpoint.c_str());
+    }
+    return true;
+}
+
+/** Parses a view flag in full precision.
+ * \return false, after saying so, if it is not a number
+ */
+bool parseHp(const char* name, const std::string& text, hpfloat* out){
+    try{
+        *out = hpfloat(text);
+    }catch(const std::exception&){
+        fprintf(stderr, "-%s=%s is not a number\n", name, text.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** Centres -check_kernels zooms into: the full set, make test and the
+ * two examples, the latter cut short since float only lasts a few
+ * hundred frames anyway.
+ */
+const char* CHECK_VIEWS[][2] = {
+    {"-.75", "0"},
+    {"0.001643721971153", "0.822467633298876"},
+    {"-1.768573656315270993281742915329544712934",
+        "-0.000964296851358280000176242720373819448"},
+    {"-1.749998410993740817490024831624283934528",
+        "-0.000000000000001657124692954186923258109"}
+};
+
+/**\brief Renders every 10th frame of the reference views that auto
+ * would render in float, once in float and once in double, and counts
+ * the pixels that differ.
+ * \return 0 if float matched double everywhere
+ */
+int checkKernels(const hpfloat& dx, const hpfloat& dy, const hpfloat& zoom){
+    rendThrData f, d;
+    uint64_t    bad = 0;
+    SDL_Init(SDL_INIT_TIMER);
+    for(size_t v = 0; v < sizeof(CHECK_VIEWS) / sizeof(CHECK_VIEWS[0]); v++){
+        zoomPath path(hpfloat(CHECK_VIEWS[v][0]), hpfloat(CHECK_VIEWS[v][1]),
+                dx, dy, zoom);
+        Uint32   tf = 0, td = 0;
+        uint64_t diff = 0;
+        int      i;
+        for(i = 0; i < FRAMES; i += 10){
+            setScale(path, i, &f);
+            setScale(path, i, &d);
+            if(pickKernel(&f) != KERNEL_FLOAT){
+                break;
+            }
+            Uint32 t0 = SDL_GetTicks();
+            KERNEL = KERNEL_FLOAT;
+            renderFrame(&f);
+            Uint32 t1 = SDL_GetTicks();
+            KERNEL = KERNEL_DOUBLE;
+            renderFrame(&d);
+            tf += t1 - t0;
+            td += SDL_GetTicks() - t1;
+            for(int64_t k = 0; k < SCR_WDTH * SCR_HGHT; k++){
+                diff += f.img[k] != d.img[k];
+            }
+        }
+        fprintf(stderr, "View %d: float to frame %d, %lu pixels differ, "
+                "float %ums, double %ums\n", (int)v, i,
+                (unsigned long)diff, tf, td);
+        bad += diff;
+    }
+    return bad != 0;
+}
+
+/** Views the golden data hold: the whole set, make test at double and
+ * double-double depth, the two examples at moderate depth and the
+ * whole of both multibrots, whose orbits leave the escape radius
+ * fastest.
+ */
+struct goldenView{
+    const char* name;
+    const char* cx;
+    const char* cy;
+    int64_t     frame;
+    formulaType formula;
+};
+const goldenView GOLDEN_VIEWS[] = {
+    {"full", CHECK_VIEWS[0][0], CHECK_VIEWS[0][1], 0, FORMULA_MANDELBROT},
+    {"test", CHECK_VIEWS[1][0], CHECK_VIEWS[1][1], 300, FORMULA_MANDELBROT},
+    {"test-deep", CHECK_VIEWS[1][0], CHECK_VIEWS[1][1], 900,
+        FORMULA_MANDELBROT},
+    {"ex1", CHECK_VIEWS[2][0], CHECK_VIEWS[2][1], 700, FORMULA_MANDELBROT},
+    {"ex2", CHECK_VIEWS[3][0], CHECK_VIEWS[3][1], 250, FORMULA_MANDELBROT},
+    {"multibrot3", "0", "0", 0, FORMULA_CUBIC},
+    {"multibrot4", "0", "0", 0, FORMULA_QUARTIC}
+};
+const int GOLDEN_WIDTH = 160;    //!< Small enough to keep in git
+
+/** Writes counts as a text header and then 16 bit little endian counts,
+ * column by column like the image arrays.
+ */
+bool saveGolden(const std::string& path, const uint64_t* img){
+    FILE* f = fopen(path.c_str(), "wb");
+    if(!f){
+        return false;
+    }
+    fprintf(f, "mandelbrot-golden 1 %ld %ld %d\n", (long)SCR_WDTH,
+            (long)SCR_HGHT, MAX_ITER);
+    for(int64_t k = 0; k < SCR_WDTH * SCR_HGHT; k++){
+        fputc(img[k] & 0xff, f);
+        fputc(img[k] >> 8, f);
+    }
+    return fclose(f) == 0;
+}
+
+/** Reads back what saveGolden() wrote, false if it is missing or was
+ * made at another size.
+ */
+bool loadGolden(const std::string& path, std::vector<uint64_t>* out){
+    FILE* f = fopen(path.c_str(), "rb");
+    long  w, h;
+    int   iter;
+    if(!f){
+        return false;
+    }
+    if(fscanf(f, "mandelbrot-golden 1 %ld %ld %d", &w, &h, &iter) != 3 ||
+            fgetc(f) != '\n' || w != SCR_WDTH || h != SCR_HGHT ||
+            iter != MAX_ITER){
+        fclose(f);
+        return false;
+    }
+    out->resize(w * h);
+    for(int64_t k = 0; k < w * h; k++){
+        int lo = fgetc(f);
+        int hi = fgetc(f);
+        if(hi == EOF){
+            fclose(f);
+            return false;
+        }
+        (*out)[k] = lo | hi << 8;
+    }
+    fclose(f);
+    return true;
+}
+
+/** Saves a picture of where a render and its golden data disagree:
+ * the golden counts in grey, pixels that came out lower in red and
+ * higher in green.
+ */
+bool saveMismatchMap(const std::string& path, const uint64_t* img,
+        const std::vector<uint64_t>& golden){
+    SDL_Surface* map = SDL_CreateRGBSurface(SDL_SWSURFACE, SCR_WDTH,
+            SCR_HGHT, SCR_CD, 0, 0, 0, 0);
+    if(!map){
+        return false;
+    }
+    for(int x = 0; x < SCR_WDTH; x++){
+        for(int y = 0; y < SCR_HGHT; y++){
+            uint64_t g = golden[x * SCR_HGHT + y];
+            uint64_t v = img[x * SCR_HGHT + y];
+            pixel    p;
+            p.r = p.g = p.b = g * 96 / MAX_ITER;
+            if(v < g){
+                p.r = 255;
+            }else if(v > g){
+                p.g = 255;
+            }
+            put_px(map, x, y, &p);
+        }
+    }
+    bool ok = SDL_SaveBMP(map, path.c_str()) == 0;
+    SDL_FreeSurface(map);
+    return ok;
+}
+
+/**\brief Renders the golden views with every kernel at every
+ * instruction set this CPU has and compares the counts with the golden
+ * data, or with update, rewrites the golden data with quad-double.
+ *
+ * A kernel only has to match on views it resolves, the ones auto could
+ * pick it for. There it may get at most -golden_tolerance of the pixels
+ * wrong, since rounding differently does change the counts of a few
+ * pixels right on the boundary. A mismatch map is saved for every
+ * kernel that fails. Each view is also traced the way -boundary does
+ * it, which has to match a full render pixel for pixel.
+ * \return 0 if every kernel passed
+ */
+int runGolden(const std::string& mode){
+    hpfloat  dx("3.5"), dy("2"), zoom(".05");
+    isaLevel best = ISA;
+    int      failed = 0;
+    SCR_WDTH = GOLDEN_WIDTH;
+    SCR_HGHT = ((double)SCR_WDTH / 3.5) * 2;
+    TILES_X  = (SCR_WDTH + FLAGS_tile - 1) / FLAGS_tile;
+    TILES_Y  = (SCR_HGHT + FLAGS_tile - 1) / FLAGS_tile;
+    if(mode != "check" && mode != "update"){
+        fprintf(stderr, "-golden wants check or update\n");
+        return 1;
+    }
+    for(size_t v = 0; v < sizeof(GOLDEN_VIEWS) / sizeof(GOLDEN_VIEWS[0]);
+            v++){
+        const goldenView&     g = GOLDEN_VIEWS[v];
+        // Each view says its own formula, whatever -formula says
+        FORMULA = g.formula;
+        std::string           file = FLAGS_golden_dir + "/" + g.name + ".golden";
+        std::vector<uint64_t> golden;
+        zoomPath              path(hpfloat(g.cx), hpfloat(g.cy), dx, dy, zoom);
+        rendThrData           d;
+        setScale(path, g.frame, &d);
+        if(mode == "update"){
+            KERNEL = KERNEL_QD;
+            renderFrame(&d);
+            if(!saveGolden(file, d.img)){
+                fprintf(stderr, "Couldn't write %s\n", file.c_str());
+                return 1;
+            }
+            fprintf(stderr, "Wrote %s\n", file.c_str());
+            continue;
+        }
+        if(!loadGolden(file, &golden)){
+            fprintf(stderr, "No golden data in %s for %ldx%ld\n",
+                    file.c_str(), (long)SCR_WDTH, (long)SCR_HGHT);
+            failed++;
+            continue;
+        }
+        for(int i = ISA_SSE2; i <= best; i++){
+            ISA = (isaLevel)i;
+            for(int k = KERNEL_AUTO; k <= KERNEL_FIXED; k++){
+                uint64_t diff = 0, worst = 0;
+                KERNEL = (kernelType)k;
+                if(!resolves(KERNEL, &d)){
+                    continue;
+                }
+                renderFrame(&d);
+                for(int64_t p = 0; p < SCR_WDTH * SCR_HGHT; p++){
+                    uint64_t e = d.img[p] > golden[p] ?
+                        d.img[p] - golden[p] : golden[p] - d.img[p];
+                    diff  += e != 0;
+                    worst  = e > worst ? e : worst;
+                }
+                double frac = (double)diff / (SCR_WDTH * SCR_HGHT);
+                bool   ok   = frac <= FLAGS_golden_tolerance;
+                fprintf(stderr, "%-10s %-7s %-7s %6lu px %7.3f%% max %4lu %s\n",
+                        g.name, KERNEL_NAMES[k], ISA_NAMES[i],
+                        (unsigned long)diff, frac * 100.0,
+                        (unsigned long)worst, ok ? "ok" : "FAIL");
+                if(!ok){
+                    std::string map = std::string("mismatch-") + g.name +
+                        "-" + KERNEL_NAMES[k] + "-" + ISA_NAMES[i] + ".bmp";
+                    saveMismatchMap(map, d.img, golden);
+                    failed++;
+                }
+            }
+        }
+        ISA = best;
+        // -boundary has to give the counts a full render gives
+        KERNEL = KERNEL_AUTO;
+        renderFrame(&d);
+        std::vector<uint64_t> full(d.img, d.img + SCR_WDTH * SCR_HGHT);
+        for(int t = 0; t < TILES_X * TILES_Y; t++){
+            traceTile(&d, tileRect(t));
+        }
+        uint64_t diff = 0;
+        for(int64_t p = 0; p < SCR_WDTH * SCR_HGHT; p++){
+            diff += d.img[p] != full[p];
+        }
+        fprintf(stderr, "%-10s %-7s %-7s %6lu px grid %d %s\n", g.name,
+                "trace", ISA_NAMES[ISA], (unsigned long)diff,
+                FLAGS_boundary_grid, diff ? "FAIL" : "ok");
+        if(diff){
+            std::string map = std::string("mismatch-") + g.name + "-trace.bmp";
+            saveMismatchMap(map, d.img, full);
+            failed++;
+        }
+    }
+    if(mode == "check"){
+        fprintf(stderr, failed ? "%d golden checks failed\n" :
+                "All golden checks passed\n", failed);
+    }
+    return failed != 0;
+}
+
+/** Regions the kernel benchmarks render, which stress different things:
+ * every pixel running to MAX_ITER, a mix of long and short orbits that
+ * keeps lanes waiting on each other, and everything escaping at once.
+ */
+struct benchView{
+    const char* name;
+    long double cx;          //!< Centre
+    long double cy;
+    long double hx;          //!< Half the width, the height follows
+};
+const benchView BENCH_VIEWS[] = {
+    {"interior", -0.15L, 0.0L, 0.15L},
+    {"boundary", -0.7436447860L, 0.1318252536L, 0.00003L},
+    {"exterior", 1.5L, 1.5L, 0.5L}
+};
+
+/** What the benchmarked functions work on */
+struct benchWork{
+    rendThrData*    d;
+    SDL_Surface*    screen;
+    const zoomPath* path;
+    int64_t         frame;
+};
+
+/** One call of a benchmark, returning the escape iterations it did */
+typedef uint64_t (*benchFn)(benchWork*);
+
+uint64_t benchKernel(benchWork* w){
+    uint64_t itr = 0;
+    renderFrame(w->d);
+    for(int64_t k = 0; k < SCR_WDTH * SCR_HGHT; k++){
+        itr += w->d->img[k];
+    }
+    return itr;
+}
+
+uint64_t benchColor(benchWork* w){
+    colorFrame(w->screen, w->d->img);
+    return 0;
+}
+
+uint64_t benchSetScale(benchWork* w){
+    setScale(*w->path, w->frame, w->d);
+    w->frame = (w->frame + 1) % FRAMES;
+    return 0;
+}
+
+double nowSec(){
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** Calls fn over and over for -bench_time seconds and writes out one
+ * entry of the report.
+ * \param items Pixels, or calls, each call of fn accounts for
+ */
+void benchmark(const std::string& name, benchFn fn, benchWork* w,
+        uint64_t items, bool* first){
+    uint64_t n   = 0;
+    uint64_t itr = 0;
+    double   t0  = nowSec();
+    double   t;
+    do{
+        itr += fn(w);
+        n++;
+        t = nowSec() - t0;
+    }while(t < FLAGS_bench_time);
+    printf("%s    {\n"
+           "      \"name\": \"%s\",\n"
+           "      \"iterations\": %lu,\n"
+           "      \"real_time\": %.1f,\n"
+           "      \"time_unit\": \"ns\",\n"
+           "      \"items_per_second\": %.6g",
+           *first ? "" : ",\n", name.c_str(), (unsigned long)n, t * 1e9 / n,
+           n * items / t);
+    if(itr){
+        printf(",\n      \"escape_iterations_per_second\": %.6g", itr / t);
+    }
+    printf("\n    }");
+    fprintf(stderr, "%-32s %10.3f ms %12.4g items/s\n", name.c_str(),
+            t * 1e3 / n, n * items / t);
+    *first = false;
+}
+
+/**\brief Times every kernel in every region at each instruction set up
+ * to ISA, the colouring loop and setScale(), and prints a report on
+ * stdout in Google Benchmark's JSON format.
+ */
+int runBench(const zoomPath& path){
+    rendThrData d;
+    benchWork   w = {&d, NULL, &path, 0};
+    bool        first = true;
+    char        date[32];
+    time_t      now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    printf("{\n  \"context\": {\n"
+           "    \"date\": \"%s\",\n"
+           "    \"num_cpus\": %ld,\n"
+           "    \"isa\": \"%s\",\n"
+           "    \"width\": %ld,\n"
+           "    \"height\": %ld,\n"
+           "    \"max_iter\": %d\n"
+           "  },\n  \"benchmarks\": [\n", date, sysconf(_SC_NPROCESSORS_ONLN),
+           ISA_NAMES[ISA], (long)SCR_WDTH, (long)SCR_HGHT, MAX_ITER);
+    isaLevel best = ISA;
+    for(int i = ISA_SSE2; i <= best; i++){
+        ISA = (isaLevel)i;
+        for(size_t v = 0; v < sizeof(BENCH_VIEWS) / sizeof(BENCH_VIEWS[0]);
+                v++){
+            const benchView& b = BENCH_VIEWS[v];
+            d.cx    = hpfloat(b.cx);
+            d.cy    = hpfloat(b.cy);
+            d.hx    = b.hx;
+            d.hy    = b.hx * SCR_HGHT / SCR_WDTH;
+            d.xmin  = b.cx - d.hx;
+            d.xmax  = b.cx + d.hx;
+            d.ymin  = b.cy - d.hy;
+            d.ymax  = b.cy + d.hy;
+            for(int k = KERNEL_FLOAT; k <= KERNEL_FIXED; k++){
+                KERNEL = (kernelType)k;
+                if(KERNEL == KERNEL_FIXED && !fixedHolds()){
+                    continue;
+                }
+                benchmark(std::string("BM_kernel/") + KERNEL_NAMES[k] + "/" +
+                        b.name + "/" + ISA_NAMES[i], benchKernel, &w,
+                        SCR_WDTH * SCR_HGHT, &first);
+            }
+        }
+    }
+    ISA = best;
+    w.screen = SDL_CreateRGBSurface(SDL_SWSURFACE, SCR_WDTH, SCR_HGHT,
+            SCR_CD, 0, 0, 0, 0);
+    if(!w.screen){
+        fprintf(stderr, "SDL_CreateRGBSurface: %s\n", SDL_GetError());
+        return 1;
+    }
+    benchmark("BM_colorFrame", benchColor, &w, SCR_WDTH * SCR_HGHT, &first);
+    benchmark("BM_setScale", benchSetScale, &w, 1, &first);
+    printf("\n  ]\n}\n");
+    SDL_FreeSurface(w.screen);
+    return 0;
+}
+
+/** Opens the window the zoom is drawn in. */
+SDL_Surface* openScreen(){
+    SDL_Init(SDL_INIT_EVERYTHING); 
+    return SDL_SetVideoMode(SCR_WDTH, SCR_HGHT, SCR_CD, SDL_SWSURFACE);
+}
+
+/** Where a forked worker leaves its spans for the parent */
+std::string traceChildPath(pid_t pid){
+    return FLAGS_trace + "." + std::to_string(pid);
+}
+
+/** Writes out the trace and its summary, if -trace asked for one. */
+void traceFinish(){
+    if(!TRACE_ON){
+        return;
+    }
+    if(!traceWrite(FLAGS_trace.c_str())){
+        fprintf(stderr, "Couldn't write trace %s\n", FLAGS_trace.c_str());
+    }
+    traceSummary(stderr);
+}
+
+/** Black through red and yellow to white as t goes from 0 to 1 */
+pixel heatColor(double t){
+    pixel p;
+    t   = t < 0 ? 0 : t > 1 ? 1 : t;
+    p.r = t < 1.0 / 3 ? t * 3 * 255 : 255;
+    p.g = t < 1.0 / 3 ? 0 : t < 2.0 / 3 ? (t * 3 - 1) * 255 : 255;
+    p.b = t < 2.0 / 3 ? 0 : (t * 3 - 2) * 255;
+    return p;
+}
+
+/** Saves a heatmap of per pixel values, scaled so the largest is white */
+bool saveHeatmap(const std::string& path, const std::vector<double>& v){
+    SDL_Surface* map = SDL_CreateRGBSurface(SDL_SWSURFACE, SCR_WDTH,
+            SCR_HGHT, SCR_CD, 0, 0, 0, 0);
+    double       top = *std::max_element(v.begin(), v.end());
+    if(!map){
+        return false;
+    }
+    for(int x = 0; x < SCR_WDTH; x++){
+        for(int y = 0; y < SCR_HGHT; y++){
+            pixel p = heatColor(top > 0 ? v[x * SCR_HGHT + y] / top : 0);
+            put_px(map, x, y, &p);
+        }
+    }
+    bool ok = SDL_SaveBMP(map, path.c_str()) == 0;
+    SDL_FreeSurface(map);
+    if(!ok){
+        fprintf(stderr, "Couldn't write %s\n", path.c_str());
+    }
+    return ok;
+}
+
+/** One renderer's tiles in time order, with running totals of how long
+ * it had been busy, to find how busy it was over any stretch of time.
+ */
+struct busyTimes{
+    std::vector<std::pair<uint64_t, uint64_t> > spans;
+    std::vector<uint64_t>                       before;  //!< Busy before span k
+
+    void finish(){
+        std::sort(spans.begin(), spans.end());
+        before.assign(1, 0);
+        for(size_t k = 0; k < spans.size(); k++){
+            before.push_back(before.back() + spans[k].second - spans[k].first);
+        }
+    }
+    //!< Nanoseconds spent rendering between a and b
+    uint64_t busy(uint64_t a, uint64_t b) const{
+        size_t i = 0, j = spans.size();
+        while(i < j && spans[i].second <= a){
+            i++;
+        }
+        while(j > i && spans[j - 1].first >= b){
+            j--;
+        }
+        if(i >= j){
+            return 0;
+        }
+        uint64_t t = before[j] - before[i];
+        if(spans[i].first < a){
+            t -= a - spans[i].first;
+        }
+        if(spans[j - 1].second > b){
+            t -= spans[j - 1].second - b;
+        }
+        return t;
+    }
+};
+
+/** Value at percentile p of sorted values */
+double percentile(const std::vector<double>& v, double p){
+    size_t k = (size_t)(p / 100.0 * v.size());
+    return v.empty() ? 0 : v[k < v.size() ? k : v.size() - 1];
+}
+
+/**\brief Writes out where the time went for -heatmap.
+ *
+ * PREFIX-pixels.bmp sums each pixel's iterations over the frames drawn
+ * and PREFIX-tiles.bmp the render time per pixel of the pieces each
+ * pixel was rendered in. PREFIX.csv has a line per frame with its mean
+ * and slowest piece and how idle each renderer was while the frame was
+ * being rendered, from its first piece starting to its last finishing.
+ * Time a renderer spent on other frames then counts as busy.
+ */
+void heatmapReport(const tileCosts& costs, const std::vector<uint64_t>& px,
+        int workers, int first, int end){
+    std::vector<double>    tileTime(SCR_WDTH * SCR_HGHT);
+    std::vector<double>    pixelItr(px.begin(), px.end());
+    std::vector<busyTimes> busy(workers);
+    std::vector<double>    ratios, idles;
+    std::string            csv = FLAGS_heatmap + ".csv";
+    FILE*                  f = fopen(csv.c_str(), "w");
+    int                    tiles = costs.size();
+    if(!f || end <= first){
+        fprintf(stderr, "Couldn't write %s\n", csv.c_str());
+        if(f){
+            fclose(f);
+        }
+        return;
+    }
+    for(int64_t fr = first; fr < end; fr++){
+        for(int t = 0; t < tiles; t++){
+            const tileCost& c = costs.at(fr, t);
+            const tileBox&  b = c.box;
+            if(!c.end || c.worker < 0 || c.worker >= workers){
+                continue;
+            }
+            busy[c.worker].spans.push_back(std::make_pair(c.start, c.end));
+            double ms = (c.end - c.start) / 1e6 /
+                ((b.right - b.left) * (b.bottom - b.top));
+            for(int x = b.left; x < b.right; x++){
+                for(int y = b.top; y < b.bottom; y++){
+                    tileTime[x * SCR_HGHT + y] += ms;
+                }
+            }
+        }
+    }
+    for(int w = 0; w < workers; w++){
+        busy[w].finish();
+    }
+    fprintf(f, "frame,mean_tile_ms,max_tile_ms,max_over_mean,"
+            "mean_tile_iterations,max_tile_iterations,render_ms");
+    for(int w = 0; w < workers; w++){
+        fprintf(f, ",idle_pct_%d", w);
+    }
+    fprintf(f, "\n");
+    for(int64_t fr = first; fr < end; fr++){
+        uint64_t a = UINT64_MAX, b = 0;
+        double   sum = 0, top = 0, itr = 0, topItr = 0;
+        int      n = 0;
+        for(int t = 0; t < tiles; t++){
+            const tileCost& c = costs.at(fr, t);
+            double          ms = (c.end - c.start) / 1e6;
+            // Claims past the end of the frame's plan rendered nothing
+            if(!c.end){
+                continue;
+            }
+            n++;
+            a       = std::min(a, c.start);
+            b       = std::max(b, c.end);
+            sum    += ms;
+            top     = std::max(top, ms);
+            itr    += c.iterations;
+            topItr  = std::max(topItr, (double)c.iterations);
+        }
+        if(n == 0){
+            continue;
+        }
+        ratios.push_back(sum > 0 ? top / (sum / n) : 1);
+        fprintf(f, "%ld,%.4f,%.4f,%.3f,%.0f,%.0f,%.4f", (long)fr, sum / n,
+                top, ratios.back(), itr / n, topItr, (b - a) / 1e6);
+        for(int w = 0; w < workers; w++){
+            double idle = b > a ? 100.0 * (1 - (double)busy[w].busy(a, b) /
+                    (b - a)) : 0;
+            idles.push_back(idle);
+            fprintf(f, ",%.2f", idle);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    saveHeatmap(FLAGS_heatmap + "-pixels.bmp", pixelItr);
+    saveHeatmap(FLAGS_heatmap + "-tiles.bmp", tileTime);
+    std::sort(ratios.begin(), ratios.end());
+    std::sort(idles.begin(), idles.end());
+    fprintf(stderr, "Slowest over mean tile per frame: p50 %.2f p90 %.2f "
+            "max %.2f\n", percentile(ratios, 50), percentile(ratios, 90),
+            ratios.back());
+    fprintf(stderr, "Renderer idle %% per frame: p50 %.1f p90 %.1f "
+            "max %.1f\n", percentile(idles, 50), percentile(idles, 90),
+            idles.back());
+    fprintf(stderr, "Wrote %s, %s-pixels.bmp and %s-tiles.bmp\n",
+            csv.c_str(), FLAGS_heatmap.c_str(), FLAGS_heatmap.c_str());
+}
+
+/** A hash of every flag that changes the counts of a frame, so a shard
+ * worker started with a view of its own can be told apart.
+ */
+uint64_t viewHash(){
+    const char* names[] = {"orgX", "orgY", "DX", "DY", "ZOOM",
+        "screen_width", "tile", "kernel", "formula", "power", "julia_x",
+        "julia_y", "aa", "aa_threshold", "smooth", "distance", "equalize",
+        "boundary", "boundary_grid"};
+    uint64_t    h = 14695981039346656037ULL;   // FNV-1a
+    for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        std::string v;
+        gflags::GetCommandLineOption(names[i], &v);
+        v = std::string(names[i]) + "=" + v + "\n";
+        for(size_t k = 0; k < v.size(); k++){
+            h = (h ^ (unsigned char)v[k]) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+/** Draws the zoom with frames rendered by worker processes. */
+int runSharded(const zoomPath& path, int start){
+    SDL_Surface*     screen;
+    shardCoordinator coord(framePixels(), viewHash(), start, FRAMES,
+            FLAGS_shard_depth);
+    uint64_t         t = traceNow();
+    // Fork the workers before SDL is up so they carry none of it
+    if(!coord.listen(FLAGS_shard_bind.c_str(), FLAGS_shard_port) ||
+            !coord.spawnLocal(FLAGS_procs, renderShard, (void*)&path)){
+        return 1;
+    }
+    // Workers allocate their buffer on their first frame, which can't
+    // come before they have connected and been pinned
+    for(size_t k = 0; k < coord.local().size(); k++){
+        pinWorker(coord.local()[k], k);
+    }
+    traceEnd(PHASE_SPAWN, t, -1);
+    screen = openScreen();
+    for(int i = start; i < FRAMES; i++){
+        t = traceNow();
+        const uint64_t* img = coord.wait(i);
+        traceEnd(PHASE_WAIT, t, i);
+        if(!img || !drawFrame(screen, img, i)){
+            return 1;
+        }
+        coord.release(i);
+    }
+    return 0;
+}
+
+/** One zoom of a batch and the ring it is rendered through. The ring
+ * and its plans only exist while the zoom is open.
+ */
+struct batchRun{
+    zoomPath          path;
+    std::string       where;   //!< Its line of the batch file
+    std::string       out;     //!< Frames are written to out-NNNNN.bmp
+    int               frames;
+    int               every;   //!< Frames between the ones written
+    int               cap;     //!< Render threads it may have at once
+    tilePlanner*      plan;
+    frameRing*        ring;
+    pthread_t         writer;
+    std::atomic<bool> written; //!< Its writer is done
+    int               rc;
+
+    batchRun(const zoomPath& z) : path(z), frames(FRAMES), every(1),
+        cap(THREADS), plan(NULL), ring(NULL), written(false), rc(0){}
+};
+
+/** A tile of a batch zoom, as a render thread claimed it. */
+struct batchClaim{
+    int64_t frame;
+    int     tile;
+};
+
+/** batchPool::claimFn for batch zooms. Only tiles that can be rendered
+ * straight away are taken, so no thread waits on one zoom's writer
+ * while another zoom has work.
+ */
+bool claimBatch(void* job, void* out){
+    batchClaim* c = (batchClaim*)out;
+    return ((batchRun*)job)->ring->tryClaim(&c->frame, &c->tile);
+}
+
+struct batchWork{
+    batchPool* pool;
+    int        worker;       //!< This renderer's number
+};
+
+/** Renders tiles of whichever batch zoom the pool hands out until it is
+ * told to finish.
+ */
+void* batchThread(void* data){
+    const batchWork* w  = (batchWork*)data;
+    const batchRun*  on = NULL;   // zoom d is scaled for
+    rendThrData      d(NULL);
+    batchClaim       c;
+    tileBox          b;
+    pinWorker(0, w->worker);
+    traceThread("render");
+    while(batchRun* r = (batchRun*)w->pool->pick(claimBatch, &c)){
+        // Never waits, the claim made sure the slot was free
+        d.img = r->ring->acquire(c.frame);
+        if(r->plan->piece(c.frame, c.tile, &b)){
+            traceScope span(PHASE_RENDER, c.frame, c.tile);
+            if(on != r || d.frame != c.frame){
+                setScale(r->path, c.frame, &d);
+                on = r;
+            }
+            renderPiece(&d, b);
+            r->plan->record(c.frame, b, d.img);
+        }
+        r->ring->finish(c.frame);
+        w->pool->leave(r);
+    }
+    pthread_exit(NULL);
+}
+
+/** Takes each frame of a batch zoom off its ring in turn, writes the
+ * ones due and plans the frames after it.
+ */
+void* batchWriter(void* data){
+    batchRun*    r = (batchRun*)data;
+    SDL_Surface* s = SDL_CreateRGBSurface(SDL_SWSURFACE, SCR_WDTH,
+            SCR_HGHT, SCR_CD, 0, 0, 0, 0);
+    double       ratio = pow(r->path.shrink, hpfloat(r->ring->size()))
+        .convert_to<double>();
+    char         name[32];
+    traceThread("write");
+    if(!s){
+        fprintf(stderr, "SDL_CreateRGBSurface: %s\n", SDL_GetError());
+        r->rc = 1;
+    }
+    for(int i = 0; s && i < r->frames; i++){
+        uint64_t* img = r->ring->wait(i);
+        if(!img){
+            r->rc = 1;
+            break;
+        }
+        if(i % r->every == 0 || i == r->frames - 1){
+            traceScope  span(PHASE_COLOR, i);
+            std::string path = r->out;
+            snprintf(name, sizeof(name), "-%05d.bmp", i);
+            path += name;
+            colorFrame(s, img);
+            if(SDL_SaveBMP(s, path.c_str()) != 0){
+                fprintf(stderr, "Couldn't write %s\n", path.c_str());
+                r->rc = 1;
+                break;
+            }
+            printf("Wrote %s\n", path.c_str());
+        }
+        if(FLAGS_equalize){
+            memset(img + planeAt(PLANE_HIST), 0,
+                    (MAX_ITER + 1) * sizeof(uint64_t));
+        }
+        r->plan->plan(i, ratio);
+        r->ring->release(i);
+    }
+    if(r->rc){
+        // Nothing more of it will be drawn, let the renderers go
+        r->ring->stop();
+    }
+    SDL_FreeSurface(s);
+    r->written.store(true);
+    pthread_exit(NULL);
+}
+
+/** Whether a batch zoom's flag leaves the batch's own setting alone.
+ * Both are put through gflags so they compare the way gflags prints
+ * them, and the flag is set back afterwards.
+ */
+bool sameSetting(const std::string& where, std::string name,
+        std::string value){
+    std::string now, asked;
+    if(!gflags::GetCommandLineOption(name.c_str(), &now) && value.empty() &&
+            name.compare(0, 2, "no") == 0){
+        name  = name.substr(2);
+        value = "false";
+    }
+    if(!gflags::GetCommandLineOption(name.c_str(), &now)){
+        fprintf(stderr, "%s: unknown flag -%s\n", where.c_str(),
+                name.c_str());
+        return false;
+    }
+    if(gflags::SetCommandLineOption(name.c_str(),
+                value.empty() ? "true" : value.c_str()).empty()){
+        fprintf(stderr, "%s: bad value for -%s\n", where.c_str(),
+                name.c_str());
+        return false;
+    }
+    gflags::GetCommandLineOption(name.c_str(), &asked);
+    gflags::SetCommandLineOption(name.c_str(), now.c_str());
+    if(asked != now){
+        fprintf(stderr, "%s: -%s is shared by the whole batch, give it on "
+                "the command line\n", where.c_str(), name.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** A whole number from a batch zoom's flag, def if it has none.
+ * \return false, after saying so, if it is not one from least to most
+ */
+bool jobInt(const batchJob& job, const char* name, int def, int least,
+        int most, int* out){
+    std::string v;
+    char*       end;
+    *out = def;
+    if(!job.find(name, &v)){
+        return true;
+    }
+    long n = strtol(v.c_str(), &end, 10);
+    if(v.empty() || *end || n < least || n > most){
+        if(most == INT32_MAX){
+            fprintf(stderr, "%s: -%s must be a whole number of at least "
+                    "%d\n", job.where.c_str(), name, least);
+        }else{
+            fprintf(stderr, "%s: -%s must be a whole number from %d to "
+                    "%d\n", job.where.c_str(), name, least, most);
+        }
+        return false;
+    }
+    *out = n;
+    return true;
+}
+
+/** Works out a batch zoom from its flags, with the view flags it leaves
+ * out taken from the command line.
+ * \return NULL, after saying why, if its flags don't make a zoom
+ */
+batchRun* readJob(const batchJob& job, int number){
+    const char* view[] = {"orgX", "orgY", "DX", "DY", "ZOOM"};
+    std::string text[] = {FLAGS_orgX, FLAGS_orgY, FLAGS_DX, FLAGS_DY,
+        FLAGS_ZOOM};
+    hpfloat     v[5];
+    std::string out = "job" + std::to_string(number);
+    int         frames, every, cap;
+    for(size_t i = 0; i < job.flags.size(); i++){
+        const std::string& name = job.flags[i].first;
+        bool ours = name == "out" || name == "frames" || name == "every" ||
+            name == "cap";
+        for(int k = 0; k < 5; k++){
+            ours = ours || name == view[k];
+        }
+        if(!ours && !sameSetting(job.where, name, job.flags[i].second)){
+            return NULL;
+        }
+    }
+    for(int k = 0; k < 5; k++){
+        job.find(view[k], &text[k]);
+        if(!parseHp(view[k], text[k], &v[k])){
+            return NULL;
+        }
+    }
+    job.find("out", &out);
+    if(!jobInt(job, "frames", FRAMES, 1, FRAMES, &frames) ||
+            !jobInt(job, "every", FLAGS_batch_every, 1, INT32_MAX, &every) ||
+            !jobInt(job, "cap", FLAGS_batch_cap > 0 ? FLAGS_batch_cap :
+                THREADS, 1, INT32_MAX, &cap)){
+        return NULL;
+    }
+    if(v[2] <= 0 || v[3] <= 0){
+        fprintf(stderr, "%s: -DX and -DY must be above 0\n",
+                job.where.c_str());
+        return NULL;
+    }
+    // Every zoom shares the batch's frame size
+    int height = ((double)SCR_WDTH / v[2].convert_to<double>()) *
+        v[3].convert_to<double>();
+    if(height != SCR_HGHT){
+        fprintf(stderr, "%s: -DX and -DY make %ld by %d frames, the batch "
+                "renders %ld by %ld\n", job.where.c_str(), (long)SCR_WDTH,
+                height, (long)SCR_WDTH, (long)SCR_HGHT);
+        return NULL;
+    }
+    batchRun* r = new batchRun(zoomPath(v[0], v[1], v[2], v[3], v[4]));
+    r->where  = job.where;
+    r->out    = out;
+    r->frames = frames;
+    r->every  = every;
+    r->cap    = cap;
+    return r;
+}
+
+/** Gives a batch zoom its ring and starts its writer. */
+bool openJob(batchPool* pool, batchRun* r){
+    r->plan = new tilePlanner(SCR_WDTH, SCR_HGHT, FLAGS_tile, FLAGS_ahead,
+            FLAGS_schedule == "cost");
+    r->ring = new frameRing(framePixels(), FLAGS_ahead, 0, r->frames,
+            r->plan->capacity());
+    int rc = 0;
+    if(r->plan->ok() && r->ring->ok()){
+        rc = pthread_create(&r->writer, NULL, batchWriter, (void*)r);
+        if(rc){
+            fprintf(stderr, "Couldn't create thread: %d\n", rc);
+        }
+    }
+    if(!r->plan->ok() || !r->ring->ok() || rc){
+        delete r->ring;
+        delete r->plan;
+        r->ring = NULL;
+        r->plan = NULL;
+        return false;
+    }
+    pool->open(r, r->cap);
+    fprintf(stderr, "%s: started, writing %s-*.bmp\n", r->where.c_str(),
+            r->out.c_str());
+    return true;
+}
+
+/**\brief Renders every zoom of a batch file, -batch_open of them at a
+ * time, with one set of render threads shared between them.
+ *
+ * Each zoom has its own ring and planner and a writer thread of its own
+ * that saves every -every frames and the last as a bitmap. The render
+ * threads take tiles from whichever open zoom has the fewest of them on
+ * it, up to its cap, so when one zoom is down to its last frames the
+ * threads it can't use go to the next. Everything other than the view,
+ * the output and the caps is shared and comes from the command line.
+ */
+int runBatch(){
+    std::vector<batchJob>  jobs;
+    std::vector<batchRun*> runs;
+    std::vector<batchRun*> open;
+    batchPool              pool;
+    pthread_t              thrds[THREADS];
+    batchWork              work[THREADS];
+    int                    rc = 0;
+    size_t                 next;
+    if(!readBatch(FLAGS_batch, &jobs)){
+        return 1;
+    }
+    // Every zoom is checked before any of them starts
+    for(size_t k = 0; k < jobs.size(); k++){
+        batchRun* r = readJob(jobs[k], k + 1);
+        if(!r){
+            for(size_t i = 0; i < runs.size(); i++){
+                delete runs[i];
+            }
+            return 1;
+        }
+        runs.push_back(r);
+    }
+    uint64_t t = traceNow();
+    for(int i = 0; i < THREADS; i++){
+        batchWork w = {&pool, i};
+        work[i] = w;
+        int e = pthread_create(&thrds[i], NULL, batchThread, &work[i]);
+        if(e){
+            fprintf(stderr, "Couldn't create thread: %d\n", e);
+        }
+    }
+    traceEnd(PHASE_SPAWN, t, -1);
+    for(next = 0; next < runs.size() || !open.empty();){
+        while(next < runs.size() && (int)open.size() < FLAGS_batch_open){
+            if(!openJob(&pool, runs[next])){
+                // Stop opening any, the open ones still finish
+                rc   = 1;
+                next = runs.size();
+                break;
+            }
+            open.push_back(runs[next++]);
+        }
+        bool closed = false;
+        for(size_t i = 0; i < open.size(); i++){
+            batchRun* r = open[i];
+            // A renderer can still be between finishing and leaving
+            if(!r->written.load() || !pool.close(r)){
+                continue;
+            }
+            pthread_join(r->writer, NULL);
+            fprintf(stderr, "%s: %s\n", r->where.c_str(),
+                    r->rc ? "failed" : "done");
+            rc = rc ? rc : r->rc;
+            delete r->ring;
+            delete r->plan;
+            r->ring = NULL;
+            r->plan = NULL;
+            open.erase(open.begin() + i);
+            closed = true;
+            break;
+        }
+        if(!closed && !open.empty()){
+            SDL_Delay(1);
+        }
+    }
+    pool.finish();
+    for(int i = 0; i < THREADS; i++){
+        pthread_join(thrds[i], NULL);
+    }
+    for(size_t i = 0; i < runs.size(); i++){
+        delete runs[i];
+    }
+    return rc;
+}
+
+int main(int argc, char*argv[]){
+    pthread_t    thrds[THREADS];
+    SDL_Surface* screen;
+    int i, rc;
+    int start = 0;            // first frame to render
+    hpfloat orgX, orgY, dx, dy, zoom;
+    
+    // Handle command line args
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if(!parseHp("orgX", FLAGS_orgX, &orgX) ||
+            !parseHp("orgY", FLAGS_orgY, &orgY) ||
+            !parseHp("DX", FLAGS_DX, &dx) || !parseHp("DY", FLAGS_DY, &dy) ||
+            !parseHp("ZOOM", FLAGS_ZOOM, &zoom)){
+        return 1;
+    }
+    assert(dx > 0);
+    assert(dy > 0);
+    SCR_WDTH = FLAGS_screen_width;
+    SCR_HGHT = ((double)SCR_WDTH / dx.convert_to<double>()) *
+        dy.convert_to<double>();
+    if(FLAGS_tile < 1){
+        FLAGS_tile = SCR_WDTH > SCR_HGHT ? SCR_WDTH : SCR_HGHT;
+    }
+    if(FLAGS_kernel == "float"){
+        KERNEL = KERNEL_FLOAT;
+    }else if(FLAGS_kernel == "double"){
+        KERNEL = KERNEL_DOUBLE;
+    }else if(FLAGS_kernel == "ld"){
+        KERNEL = KERNEL_LD;
+    }else if(FLAGS_kernel == "dd"){
+        KERNEL = KERNEL_DD;
+    }else if(FLAGS_kernel == "qd"){
+        KERNEL = KERNEL_QD;
+    }else if(FLAGS_kernel == "fixed"){
+        KERNEL = KERNEL_FIXED;
+    }else if(FLAGS_kernel != "auto"){
+        fprintf(stderr, "Unknown -kernel %s\n", FLAGS_kernel.c_str());
+        return 1;
+    }
+    if(FLAGS_formula == "mandelbrot"){
+        FORMULA = FORMULA_MANDELBROT;
+    }else if(FLAGS_formula == "julia"){
+        FORMULA = FORMULA_JULIA;
+    }else if(FLAGS_formula == "multibrot" && FLAGS_power == 3){
+        FORMULA = FORMULA_CUBIC;
+    }else if(FLAGS_formula == "multibrot" && FLAGS_power == 4){
+        FORMULA = FORMULA_QUARTIC;
+    }else if(FLAGS_formula == "multibrot"){
+        fprintf(stderr, "-power must be 3 or 4\n");
+        return 1;
+    }else if(FLAGS_formula == "burning_ship"){
+        FORMULA = FORMULA_SHIP;
+    }else{
+        fprintf(stderr, "Unknown -formula %s\n", FLAGS_formula.c_str());
+        return 1;
+    }
+    JULIA_X = FLAGS_julia_x;
+    JULIA_Y = FLAGS_julia_y;
+    if(KERNEL == KERNEL_FIXED && !fixedHolds()){
+        fprintf(stderr, "-kernel=fixed can't hold -power=%d, use qd\n",
+                FLAGS_power);
+        return 1;
+    }
+    if(FORMULA == FORMULA_JULIA && JULIA_X * JULIA_X + JULIA_Y * JULIA_Y > 4){
+        // Past that, points in the set can get further out than 2
+        fprintf(stderr, "-julia_x and -julia_y must be within 2 of 0\n");
+        return 1;
+    }
+    if(FLAGS_schedule != "cost" && FLAGS_schedule != "grid"){
+        fprintf(stderr, "Unknown -schedule %s\n", FLAGS_schedule.c_str());
+        return 1;
+    }
+    if(FLAGS_affinity == "compact" || FLAGS_affinity == "scatter"){
+        PIN_CPUS = affinityPlan(FLAGS_affinity == "compact" ?
+                AFFINITY_COMPACT : AFFINITY_SCATTER, FLAGS_smt);
+        fprintf(stderr, "Renderers pinned to cpu/node %s\n",
+                describePlan(PIN_CPUS).c_str());
+    }else if(FLAGS_affinity != "none"){
+        fprintf(stderr, "Unknown -affinity %s\n", FLAGS_affinity.c_str());
+        return 1;
+    }
+    if(FLAGS_huge_pages == "explicit"){
+        framePages(HUGE_EXPLICIT);
+    }else if(FLAGS_huge_pages == "off"){
+        framePages(HUGE_OFF);
+    }else if(FLAGS_huge_pages != "transparent"){
+        fprintf(stderr, "Unknown -huge_pages %s\n",
+                FLAGS_huge_pages.c_str());
+        return 1;
+    }
+    if(FLAGS_aa < 1){
+        fprintf(stderr, "-aa must be at least 1\n");
+        return 1;
+    }
+    if(FLAGS_aa > 1 && FLAGS_equalize){
+        // -aa colours are mixed as the samples come in, long before
+        // the frame's histogram is known
+        fprintf(stderr, "-aa can't be used with -equalize\n");
+        return 1;
+    }
+    if(FLAGS_boundary && (FLAGS_smooth || FLAGS_distance)){
+        // Both vary across a band, so filled pixels would have none
+        fprintf(stderr, "-boundary can't be used with -smooth or "
+                "-distance\n");
+        return 1;
+    }
+    if(FLAGS_boundary_grid < 0){
+        fprintf(stderr, "-boundary_grid can't be negative\n");
+        return 1;
+    }
+    if(!FLAGS_batch.empty() && (FLAGS_procs > 0 || FLAGS_shard_port > 0 ||
+                !FLAGS_connect.empty() || FLAGS_resume ||
+                !FLAGS_checkpoint.empty() || !FLAGS_heatmap.empty())){
+        // Each of those follows a single zoom
+        fprintf(stderr, "-batch renders on threads and can't be used with "
+                "-procs, -shard_port, -connect, -checkpoint, -resume or "
+                "-heatmap\n");
+        return 1;
+    }
+    if(FLAGS_batch_open < 1 || FLAGS_batch_cap < 0 || FLAGS_batch_every < 1){
+        fprintf(stderr, "-batch_open and -batch_every must be at least 1 and "
+                "-batch_cap can't be negative\n");
+        return 1;
+    }
+    // Renderers colour -aa samples, -shm ones without ever opening a screen
+    generateColorTable();
+    ISA = isaSupported();
+    if(FLAGS_isa != "auto"){
+        i = 0;
+        while(i <= ISA_AVX512 && FLAGS_isa != ISA_NAMES[i]){
+            i++;
+        }
+        if(i > ISA_AVX512){
+            fprintf(stderr, "Unknown -isa %s\n", FLAGS_isa.c_str());
+            return 1;
+        }else if(i > ISA){
+            fprintf(stderr, "This CPU can't run -isa=%s\n", ISA_NAMES[i]);
+            return 1;
+        }
+        ISA = (isaLevel)i;
+    }
+    fprintf(stderr, "Kernels built for %s\n", ISA_NAMES[ISA]);
+    TILES_X  = (SCR_WDTH + FLAGS_tile - 1) / FLAGS_tile;
+    TILES_Y  = (SCR_HGHT + FLAGS_tile - 1) / FLAGS_tile;
+    fprintf(stderr, "WND SZ = %d by %d\n", SCR_WDTH, SCR_HGHT);
+    if(FLAGS_check_kernels){
+        return checkKernels(dx, dy, zoom);
+    }
+    if(!FLAGS_golden.empty()){
+        return runGolden(FLAGS_golden);
+    }
+    zoomPath path(orgX, orgY, dx, dy, zoom);
+    if(FLAGS_bench){
+        return runBench(path);
+    }
+    if(FLAGS_resume){
+        int64_t last;
+        if(FLAGS_checkpoint.empty()){
+            fprintf(stderr, "--resume needs -checkpoint\n");
+            return 1;
+        }
+        if(!loadCheckpoint(FLAGS_checkpoint.c_str(), &last)){
+            return 1;
+        }
+        start = last + 1;
+        fprintf(stderr, "Resuming at frame %d\n", start);
+        if(start >= FRAMES){
+            return 0;
+        }
+    }
+    if(!FLAGS_connect.empty()){
+        // Worker mode, no window, just render what the coordinator asks
+        size_t colon = FLAGS_connect.rfind(':');
+        if(colon == std::string::npos){
+            fprintf(stderr, "-connect wants host:port\n");
+            return 1;
+        }
+        return runShardWorker(FLAGS_connect.substr(0, colon).c_str(),
+                atoi(FLAGS_connect.c_str() + colon + 1),
+                framePixels(), viewHash(), renderShard, &path);
+    }
+    if(!FLAGS_trace.empty()){
+        traceStart();
+        traceThread("draw");
+    }
+    if(!FLAGS_batch.empty()){
+        rc = runBatch();
+        traceFinish();
+        return rc;
+    }
+    if((FLAGS_procs > 0 && !FLAGS_shm) || FLAGS_shard_port > 0){
+        rc = runSharded(path, start);
+        SDL_Quit();
+        traceFinish();
+        return rc;
+    }
+
+    tilePlanner plan(SCR_WDTH, SCR_HGHT, FLAGS_tile, FLAGS_ahead,
+            FLAGS_schedule == "cost");
+    frameRing   ring(framePixels(), FLAGS_ahead, start, FRAMES,
+            plan.capacity());
+    tileCosts   costs(FLAGS_heatmap.empty() ? 0 : FRAMES, plan.capacity());
+    ringWork    work[THREADS];
+    int         nthr = FLAGS_procs > 0 ? 0 : THREADS;
+    // How much smaller a frame's view is than the one its slot last held
+    double      ratio = pow(path.shrink, hpfloat(ring.size()))
+        .convert_to<double>();
+    std::vector<pid_t>    kids;
+    std::vector<uint64_t> pixelCost(costs.ok() ? SCR_WDTH * SCR_HGHT : 0);
+    if(!plan.ok() || !ring.ok() || (!FLAGS_heatmap.empty() && !costs.ok())){
+        return 1;
+    }
+    uint64_t t = traceNow();
+    // -shm workers are forked before SDL is up so they carry none of it
+    for(i = 0; i < FLAGS_procs; i++){
+        pid_t pid = fork();
+        if(pid == 0){
+            ringWork w = {&ring, &plan, &path, costs.ok() ? &costs : NULL,
+                i};
+            pinWorker(0, i);
+            traceChild("render process");
+            renderRing(&w);
+            if(TRACE_ON){
+                traceSave(traceChildPath(getpid()).c_str());
+            }
+            if(FLAGS_perf){
+                fprintf(stderr, "Counters of render process %d\n",
+                        (int)getpid());
+                perfReport(stderr, KERNEL_NAMES);
+            }
+            _exit(0);
+        }
+        if(pid < 0){
+            perror("fork");
+        }else{
+            kids.push_back(pid);
+        }
+    }
+    for(i = 0; i < nthr; i++){
+        ringWork w = {&ring, &plan, &path, costs.ok() ? &costs : NULL, i};
+        work[i] = w;
+        rc = pthread_create(&thrds[i], NULL, renderThread, (void*)&work[i]);
+        if(rc){
+            fprintf(stderr, "Couldn't create thread: %d\n", rc);
+        }
+    }
+    traceEnd(PHASE_SPAWN, t, -1);
+    screen = openScreen();
+    rc     = 0;
+    // Frames go up 1000 / fps ms apart counted from frame paced, worked
+    // out afresh each frame so rounding the period doesn't add up
+    Uint32 since = SDL_GetTicks();
+    int    paced = start;
+    for(i = start; i < FRAMES; i++){
+        t = traceNow();
+        uint64_t* img = ring.wait(i);
+        traceEnd(PHASE_WAIT, t, i);
+        if(!img){
+            rc = 1;
+            break;
+        }
+        for(size_t k = 0; k < pixelCost.size(); k++){
+            pixelCost[k] += img[k];
+        }
+        if(FLAGS_fps > 0){
+            Uint32 now = SDL_GetTicks();
+            Uint32 due = since + (Uint32)((i - paced) * 1000.0 / FLAGS_fps);
+            // Running late starts the schedule over rather than rushing
+            if((Sint32)(due - now) > 0){
+                t = traceNow();
+                SDL_Delay(due - now);
+                traceEnd(PHASE_PACE, t, i);
+            }else if((Sint32)(due - now) < 0){
+                since = now;
+                paced = i;
+            }
+        }
+        if(!drawFrame(screen, img, i)){
+            rc = 1;
+            break;
+        }
+        if(FLAGS_equalize){
+            // The slot's next frame is counted up from nothing
+            memset(img + planeAt(PLANE_HIST), 0,
+                    (MAX_ITER + 1) * sizeof(uint64_t));
+        }
+        t = traceNow();
+        plan.plan(i, ratio);
+        traceEnd(PHASE_PLAN, t, i);
+        ring.release(i);
+    }
+    int drawn = i;            // one past the last frame drawn
+    // Wake up anything still waiting on a slot so it can rejoin
+    ring.stop();
+    for(i = 0; i < nthr; i++){
+        pthread_join(thrds[i], NULL);
+    }
+    while(wait(NULL) > 0){
+    }
+    for(size_t k = 0; TRACE_ON && k < kids.size(); k++){
+        traceMerge(traceChildPath(kids[k]).c_str());
+    }
+    SDL_Quit();
+    traceFinish();
+    if(FLAGS_perf && nthr > 0){
+        perfReport(stderr, KERNEL_NAMES);
+    }
+    if(costs.ok()){
+        heatmapReport(costs, pixelCost, nthr > 0 ? nthr : FLAGS_procs, start,
+                drawn);
+    }
+    return rc;
 }
@@ -0,0 +1,182 @@
+/**\file   perf.cpp
+ * \date   October 16, 2026
+ *
+ * perf_event_open counters. Each thread opens one group, led by the
+ * cycle counter, so all of them are scheduled together and come back
+ * from a single read(). Totals live behind a mutex, which a tile taking
+ * milliseconds can afford.
+ */
+
+#include "perf.h"
+#include <algorithm>         //!< Sorting tiles by cost
+#include <cerrno>            //!< Why a counter wouldn't open
+#include <cstring>           //!< memset, strerror
+#include <map>               //!< Totals per kernel and tile
+#include <vector>            //!< Tiles to sort
+#include <pthread.h>         //!< Guarding the totals
+#include <unistd.h>          //!< syscall, read, close
+#include <sys/syscall.h>     //!< SYS_perf_event_open
+#include <linux/perf_event.h>
+
+const char* PERF_NAMES[PERF_COUNTERS] = {"cycles", "instructions",
+    "cache misses", "FP assists"};
+
+/** What a kernel or a tile has cost so far */
+struct perfTotal{
+    uint64_t v[PERF_COUNTERS];
+    uint64_t tiles;
+    uint64_t pixels;
+    uint64_t iterations;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static bool            seen[PERF_COUNTERS];   // opened on some thread
+static bool            warned = false;
+static std::map<int, perfTotal>                 byKernel;
+static std::map<std::pair<int, int>, perfTotal> byTile;
+
+static int openCounter(uint32_t type, uint64_t config, int group){
+    perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size           = sizeof(a);
+    a.type           = type;
+    a.config         = config;
+    a.read_format    = PERF_FORMAT_GROUP;
+    a.exclude_kernel = 1;    // allowed with perf_event_paranoid up to 2
+    a.exclude_hv     = 1;
+    return syscall(SYS_perf_event_open, &a, 0, -1, group, 0);
+}
+
+perfThread::perfThread(bool on, uint64_t fpAssist){
+    for(int c = 0; c < PERF_COUNTERS; c++){
+        fd[c] = -1;
+    }
+    if(!on){
+        return;
+    }
+    fd[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_CPU_CYCLES, -1);
+    if(fd[PERF_CYCLES] < 0){
+        pthread_mutex_lock(&lock);
+        if(!warned){
+            fprintf(stderr, "perf counters unavailable: %s\n",
+                    strerror(errno));
+            warned = true;
+        }
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    fd[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_INSTRUCTIONS, fd[PERF_CYCLES]);
+    fd[PERF_CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE,
+            PERF_COUNT_HW_CACHE_MISSES, fd[PERF_CYCLES]);
+    fd[PERF_FP_ASSISTS]   = openCounter(PERF_TYPE_RAW, fpAssist,
+            fd[PERF_CYCLES]);
+    pthread_mutex_lock(&lock);
+    for(int c = 0; c < PERF_COUNTERS; c++){
+        seen[c] |= fd[c] >= 0;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+perfThread::~perfThread(){
+    for(int c = PERF_COUNTERS - 1; c >= 0; c--){
+        if(fd[c] >= 0){
+            close(fd[c]);
+        }
+    }
+}
+
+bool perfThread::read(perfCounts* out) const{
+    uint64_t buf[1 + PERF_COUNTERS];
+    if(!ok() || ::read(fd[PERF_CYCLES], buf, sizeof(buf)) < 8){
+        return false;
+    }
+    // Values come back in the order the group was opened, without the
+    // counters that failed
+    int k = 1;
+    for(int c = 0; c < PERF_COUNTERS; c++){
+        out->v[c] = fd[c] >= 0 && k <= (int)buf[0] ? buf[k++] : 0;
+    }
+    return true;
+}
+
+static void addTo(perfTotal* t, const perfCounts& before,
+        const perfCounts& after, uint64_t pixels, uint64_t iterations){
+    for(int c = 0; c < PERF_COUNTERS; c++){
+        t->v[c] += after.v[c] - before.v[c];
+    }
+    t->tiles++;
+    t->pixels     += pixels;
+    t->iterations += iterations;
+}
+
+void perfAdd(int kernel, int tile, const perfCounts& before,
+        const perfCounts& after, uint64_t pixels, uint64_t iterations){
+    pthread_mutex_lock(&lock);
+    // operator[] value initialises new totals to zero
+    addTo(&byKernel[kernel], before, after, pixels, iterations);
+    addTo(&byTile[std::make_pair(kernel, tile)], before, after, pixels,
+            iterations);
+    pthread_mutex_unlock(&lock);
+}
+
+/** a / b to print, or - if a's counter never opened */
+static void printRatio(FILE* out, int counter, double a, double b){
+    if(!seen[counter] || b == 0){
+        fprintf(out, " %11s", "-");
+    }else{
+        fprintf(out, " %11.4g", a / b);
+    }
+}
+
+static void printRow(FILE* out, const perfTotal& t){
+    printRatio(out, PERF_CYCLES, t.v[PERF_CYCLES], 1e6);
+    printRatio(out, PERF_INSTRUCTIONS, t.v[PERF_INSTRUCTIONS],
+            t.v[PERF_CYCLES]);
+    printRatio(out, PERF_CYCLES, t.iterations, t.v[PERF_CYCLES]);
+    printRatio(out, PERF_CACHE_MISSES, t.v[PERF_CACHE_MISSES], t.pixels);
+    printRatio(out, PERF_FP_ASSISTS, t.v[PERF_FP_ASSISTS], t.pixels);
+    fprintf(out, "\n");
+}
+
+static bool costlier(const std::pair<std::pair<int, int>, perfTotal>& a,
+        const std::pair<std::pair<int, int>, perfTotal>& b){
+    return a.second.v[PERF_CYCLES] > b.second.v[PERF_CYCLES];
+}
+
+void perfReport(FILE* out, const char* const* kernelNames){
+    const char* head = " %11s %11s %11s %11s %11s\n";
+    pthread_mutex_lock(&lock);
+    for(int c = 0; c < PERF_COUNTERS; c++){
+        if(!seen[c]){
+            fprintf(out, "perf: no %s counter\n", PERF_NAMES[c]);
+        }
+    }
+    fprintf(out, "%-8s %8s %12s", "kernel", "tiles", "pixels");
+    fprintf(out, head, "Mcycles", "IPC", "itr/cycle", "misses/px",
+            "assists/px");
+    for(std::map<int, perfTotal>::iterator it = byKernel.begin();
+            it != byKernel.end(); ++it){
+        fprintf(out, "%-8s %8lu %12lu", kernelNames[it->first],
+                (unsigned long)it->second.tiles,
+                (unsigned long)it->second.pixels);
+        printRow(out, it->second);
+    }
+    // The costliest tiles, where tuning pays most
+    std::vector<std::pair<std::pair<int, int>, perfTotal> > tiles(
+            byTile.begin(), byTile.end());
+    std::sort(tiles.begin(), tiles.end(), costlier);
+    if(seen[PERF_CYCLES] && !tiles.empty()){
+        fprintf(out, "%-8s %8s %12s", "kernel", "tile", "renders");
+        fprintf(out, head, "Mcycles", "IPC", "itr/cycle", "misses/px",
+                "assists/px");
+        for(size_t i = 0; i < tiles.size() && i < 10; i++){
+            fprintf(out, "%-8s %8d %12lu", kernelNames[tiles[i].first.first],
+                    tiles[i].first.second,
+                    (unsigned long)tiles[i].second.tiles);
+            printRow(out, tiles[i].second);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
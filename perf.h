@@ -0,0 +1,50 @@
+/**\file   perf.h
+ * \date   October 16, 2026
+ *
+ * Hardware performance counters read around each tile through
+ * perf_event_open, and totals of them per kernel and per tile. Counters
+ * the kernel or the CPU won't give us are left out and reported as
+ * missing, so nothing breaks on virtual machines or with a strict
+ * perf_event_paranoid.
+ */
+#ifndef PERF_H
+#define PERF_H
+
+#include <cstdint>           //!< Fixed width integers
+#include <cstdio>            //!< FILE for the report
+
+/** The counters, in the order they are read */
+enum perfCounter{
+    PERF_CYCLES,             //!< Core cycles, the group leader
+    PERF_INSTRUCTIONS,       //!< Instructions retired
+    PERF_CACHE_MISSES,       //!< Last level cache misses
+    PERF_FP_ASSISTS,         //!< Microcode assists on FP, a raw event
+    PERF_COUNTERS
+};
+
+struct perfCounts{
+    uint64_t v[PERF_COUNTERS];
+};
+
+/** The counters of one thread. Open them on the thread they count. */
+class perfThread{
+public:
+    //!< Opens nothing unless on, fpAssist is the raw event for assists
+    perfThread(bool on, uint64_t fpAssist);
+    ~perfThread();
+
+    bool ok() const { return fd[PERF_CYCLES] >= 0; }
+    //!< Current counts, false if there are no counters
+    bool read(perfCounts* out) const;
+
+private:
+    int fd[PERF_COUNTERS];   //!< -1 for counters that wouldn't open
+};
+
+//!< Adds what one tile cost to the totals
+void perfAdd(int kernel, int tile, const perfCounts& before,
+        const perfCounts& after, uint64_t pixels, uint64_t iterations);
+//!< Prints the totals per kernel and the costliest tiles
+void perfReport(FILE* out, const char* const* kernelNames);
+
+#endif // PERF_H
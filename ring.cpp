@@ -0,0 +1,132 @@
+/**\file   ring.cpp
+ * \date   October 16, 2026
+ *
+ * Shared memory frame ring. Waiting is a short spin, then yielding and
+ * then short sleeps, since a frame takes milliseconds at the least and
+ * the waits work between processes without any kernel objects.
+ */
+
+#include "ring.h"
+#include "framepool.h"       //!< Huge page backed mappings
+#include <cstdio>            //!< For writing out to console
+#include <new>               //!< Placement new into the mapping
+#include <sched.h>           //!< sched_yield
+#include <time.h>            //!< nanosleep
+
+/** Backs off a little more every time it is called while waiting. */
+static void backoff(int* tries){
+    if(*tries < 64){
+        // spin
+    }else if(*tries < 256){
+        sched_yield();
+    }else{
+        timespec t = {0, 100000};
+        nanosleep(&t, NULL);
+    }
+    (*tries)++;
+}
+
+static size_t roundUp(size_t n, size_t to){
+    return (n + to - 1) / to * to;
+}
+
+frameRing::frameRing(uint64_t pixels, int slots, int64_t first, int64_t end,
+        int tiles)
+    : pixels(pixels), slots(slots < 1 ? 1 : slots),
+      tiles(tiles < 1 ? 1 : tiles), shared(0){
+    size_t head = roundUp(sizeof(ringShared) +
+            this->slots * sizeof(ringSlot), 64);
+    // Keep every buffer on its own cache lines
+    stride = roundUp(pixels * sizeof(uint64_t), 64) / sizeof(uint64_t);
+    bytes  = head + this->slots * stride * sizeof(uint64_t);
+    void* m = mapFrames(&bytes, true);
+    if(!m){
+        perror("frame ring");
+        return;
+    }
+    shared = new (m) ringShared;
+    shared->claim.store(first * this->tiles);
+    shared->consumed.store(first);
+    shared->stopped.store(false);
+    shared->end = end;
+    slot = (ringSlot*)((char*)m + sizeof(ringShared));
+    for(int i = 0; i < this->slots; i++){
+        new (&slot[i]) ringSlot;
+        slot[i].ready.store(-1);
+        slot[i].left.store(this->tiles);
+    }
+    bufs = (uint64_t*)((char*)m + head);
+}
+
+frameRing::~frameRing(){
+    if(shared){
+        unmapFrames(shared, bytes);
+    }
+}
+
+uint64_t* frameRing::buffer(int64_t frame) const{
+    return bufs + (frame % slots) * stride;
+}
+
+bool frameRing::claim(int64_t* frame, int* tile){
+    int64_t t = shared->claim.fetch_add(1);
+    *frame = t / tiles;
+    *tile  = t % tiles;
+    return *frame < shared->end;
+}
+
+bool frameRing::tryClaim(int64_t* frame, int* tile){
+    int64_t t = shared->claim.load();
+    do{
+        *frame = t / tiles;
+        if(*frame >= shared->end || shared->consumed.load(
+                    std::memory_order_acquire) + slots <= *frame){
+            return false;
+        }
+    }while(!shared->claim.compare_exchange_weak(t, t + 1));
+    *tile = t % tiles;
+    return true;
+}
+
+uint64_t* frameRing::acquire(int64_t frame){
+    int tries = 0;
+    // The slot is free once the frame slots back has been drawn
+    while(shared->consumed.load(std::memory_order_acquire) + slots <= frame){
+        if(shared->stopped.load()){
+            return NULL;
+        }
+        backoff(&tries);
+    }
+    return buffer(frame);
+}
+
+bool frameRing::finish(int64_t frame){
+    ringSlot& s = slot[frame % slots];
+    // acq_rel so the last tile sees every other tile's pixels
+    if(s.left.fetch_sub(1, std::memory_order_acq_rel) != 1){
+        return false;
+    }
+    s.ready.store(frame, std::memory_order_release);
+    return true;
+}
+
+uint64_t* frameRing::wait(int64_t frame){
+    int tries = 0;
+    while(slot[frame % slots].ready.load(std::memory_order_acquire) != frame){
+        if(shared->stopped.load()){
+            return NULL;
+        }
+        backoff(&tries);
+    }
+    return buffer(frame);
+}
+
+void frameRing::release(int64_t frame){
+    // Rearm the slot before anyone is allowed to start filling it
+    slot[frame % slots].left.store(tiles, std::memory_order_relaxed);
+    shared->consumed.store(frame + 1, std::memory_order_release);
+}
+
+void frameRing::stop(){
+    shared->stopped.store(true);
+}
@@ -0,0 +1,80 @@
+/**\file   ring.h
+ * \date   October 16, 2026
+ *
+ * A fixed ring of frame buffers in shared memory between the threads or
+ * processes rendering frames and the one drawing them. Frame f always
+ * lives in slot f % slots, so frames come out in order no matter which
+ * order the renderers finish in, and nothing is allocated per frame.
+ * Frames are split into tiles so several renderers can share a frame
+ * and several frames can be in flight at once.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>            //!< Lock free hand off
+#include <cstddef>           //!< size_t
+#include <cstdint>           //!< Fixed width integers
+
+/** Layout at the front of the shared mapping. The two counters sit on
+ * their own cache lines since one is written by the renderers and the
+ * other by the drawer.
+ */
+struct ringShared{
+    alignas(64) std::atomic<int64_t> claim;    //!< Next tile to hand out
+    alignas(64) std::atomic<int64_t> consumed; //!< Frames before are drawn
+    alignas(64) std::atomic<bool>    stopped;  //!< Set to give up waiting
+    int64_t                          end;      //!< One past the last frame
+};
+
+/** Per slot state. */
+struct ringSlot{
+    alignas(64) std::atomic<int64_t> ready;    //!< Frame in the buffer
+    std::atomic<int>                 left;     //!< Tiles still rendering
+};
+
+/** Many renderers, one drawer. Renderers claim() a tile, acquire() its
+ * frame's buffer, which waits until the drawer is done with the frame
+ * that was there slots frames ago, and finish() the tile when done. The
+ * last tile of a frame to finish publishes it. The drawer wait()s for
+ * each frame in turn and release()s it after drawing. The mapping is
+ * MAP_SHARED so processes forked after construction share it too.
+ */
+class frameRing{
+public:
+    frameRing(uint64_t pixels, int slots, int64_t first, int64_t end,
+            int tiles = 1);
+    ~frameRing();
+
+    bool ok() const { return shared != 0; }
+    int  size() const { return slots; }
+
+    //!< Next tile for a renderer, false once they are all handed out
+    bool            claim(int64_t* frame, int* tile);
+    //!< Next tile only if its frame's buffer is free already, so it can
+    //!< be acquired without waiting. False if not, or all handed out.
+    bool            tryClaim(int64_t* frame, int* tile);
+    //!< Buffer to render a claimed frame into, NULL if stopped
+    uint64_t*       acquire(int64_t frame);
+    //!< Marks a tile done, true if it was the last one of its frame
+    bool            finish(int64_t frame);
+    //!< Blocks until a frame is published, NULL if stopped. The drawer
+    //!< has the buffer to itself until it releases the frame.
+    uint64_t*       wait(int64_t frame);
+    void            release(int64_t frame);
+    //!< Wakes everything up empty handed so it can shut down
+    void            stop();
+
+private:
+    uint64_t*   buffer(int64_t frame) const;
+
+    uint64_t    pixels;
+    int         slots;
+    int         tiles;       //!< Tiles in each frame
+    size_t      bytes;       //!< Size of the whole mapping
+    size_t      stride;      //!< Pixels between slot buffers
+    ringShared* shared;
+    ringSlot*   slot;
+    uint64_t*   bufs;
+};
+
+#endif // RING_H
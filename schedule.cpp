@@ -0,0 +1,234 @@
+/**\file   schedule.cpp
+ * \date   October 16, 2026
+ *
+ * Costs are kept per cell, a quarter of a tile, since that is the
+ * smallest piece a plan cuts. Every cell belongs to exactly one piece,
+ * so renderers record them without locking, and the ring's hand off
+ * orders the drawer's reads and writes of a plan against theirs.
+ */
+
+#include "schedule.h"
+#include <algorithm>         //!< Sorting pieces by cost
+#include <cstdio>            //!< perror
+#include <vector>            //!< Tile costs while planning
+#include <sys/mman.h>        //!< Shared anonymous mapping
+
+//!< Tiles predicted over this many times the mean are split
+static const double SPLIT = 1.0;
+//!< Tiles predicted under the mean over this are merged with neighbours
+static const double MERGE = 4.0;
+//!< Most tiles merged into one piece
+static const int    MERGE_RUN = 4;
+
+static size_t roundUp(size_t n, size_t to){
+    return (n + to - 1) / to * to;
+}
+
+static bool costlier(const planPiece& a, const planPiece& b){
+    return a.cost > b.cost;
+}
+
+static uint64_t area(const tileBox& b){
+    return (uint64_t)(b.right - b.left) * (b.bottom - b.top);
+}
+
+tilePlanner::tilePlanner(int width, int height, int tile, int slots,
+        bool adapt)
+    : width(width), height(height), tile(tile), half((tile + 1) / 2),
+      tilesX((width + tile - 1) / tile), tilesY((height + tile - 1) / tile),
+      slots(slots < 1 ? 1 : slots), adapt(adapt), plans(0){
+    int tiles = tilesX * tilesY;
+    // Splitting every third tile fills the room, merging only frees some
+    cap    = adapt ? 2 * tiles : tiles;
+    stride = roundUp(roundUp(sizeof(planHead), 64) + cap * sizeof(planPiece) +
+            4 * tiles * sizeof(uint64_t), 64);
+    bytes  = this->slots * stride;
+    void* m = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(m == MAP_FAILED){
+        perror("tile plans");
+        return;
+    }
+    plans = (char*)m;
+    // Until there are costs to go on, every frame is the tiles in order
+    for(int s = 0; s < this->slots; s++){
+        planPiece* p = pieces(s);
+        head(s)->count = tiles;
+        for(int t = 0; t < tiles; t++){
+            p[t].box.left   = (t % tilesX) * tile;
+            p[t].box.top    = (t / tilesX) * tile;
+            p[t].box.right  = std::min(p[t].box.left + tile, width);
+            p[t].box.bottom = std::min(p[t].box.top + tile, height);
+            p[t].cost       = 0;
+        }
+    }
+}
+
+tilePlanner::~tilePlanner(){
+    if(plans){
+        munmap(plans, bytes);
+    }
+}
+
+tilePlanner::planHead* tilePlanner::head(int64_t frame) const{
+    return (planHead*)(plans + (frame % slots) * stride);
+}
+
+planPiece* tilePlanner::pieces(int64_t frame) const{
+    return (planPiece*)((char*)head(frame) + roundUp(sizeof(planHead), 64));
+}
+
+uint64_t* tilePlanner::cells(int64_t frame) const{
+    return (uint64_t*)(pieces(frame) + cap);
+}
+
+/** Cells are numbered 2 * tilesX across, the odd ones being the right
+ * and bottom halves of tiles. Those can be empty past the frame's edge.
+ */
+tileBox tilePlanner::cellBox(int cx, int cy) const{
+    tileBox b;
+    b.left   = std::min((cx / 2) * tile + (cx % 2) * half, width);
+    b.top    = std::min((cy / 2) * tile + (cy % 2) * half, height);
+    b.right  = std::min(cx % 2 ? (cx / 2 + 1) * tile : b.left + half, width);
+    b.bottom = std::min(cy % 2 ? (cy / 2 + 1) * tile : b.top + half, height);
+    return b;
+}
+
+/** The cell holding pixel x, y, clamped to the frame */
+int tilePlanner::cellAt(double x, double y) const{
+    int px = std::min(std::max((int)x, 0), width - 1);
+    int py = std::min(std::max((int)y, 0), height - 1);
+    int cx = 2 * (px / tile) + (px % tile >= half);
+    int cy = 2 * (py / tile) + (py % tile >= half);
+    return cy * 2 * tilesX + cx;
+}
+
+bool tilePlanner::piece(int64_t frame, int i, tileBox* box) const{
+    if(i >= head(frame)->count){
+        return false;
+    }
+    *box = pieces(frame)[i].box;
+    return true;
+}
+
+void tilePlanner::record(int64_t frame, const tileBox& box,
+        const uint64_t* img){
+    if(!adapt){
+        return;
+    }
+    uint64_t* c = cells(frame);
+    // Pieces are whole cells, so walking the cells from the piece's top
+    // left corner covers it
+    for(int cx = cellAt(box.left, 0); cx < 2 * tilesX; cx++){
+        tileBox x = cellBox(cx, 0);
+        if(x.left >= box.right){
+            break;
+        }
+        for(int cy = cellAt(0, box.top) / (2 * tilesX); cy < 2 * tilesY;
+                cy++){
+            tileBox b = cellBox(cx, cy);
+            uint64_t sum = area(b);
+            if(b.top >= box.bottom){
+                break;
+            }
+            for(int px = b.left; px < b.right; px++){
+                const uint64_t* col = img + (size_t)px * height;
+                for(int py = b.top; py < b.bottom; py++){
+                    sum += col[py];
+                }
+            }
+            c[cy * 2 * tilesX + cx] = sum;
+        }
+    }
+}
+
+/**\brief Works out the next plan for frame's slot.
+ *
+ * Each cell of the coming frame is predicted from the cell of this one
+ * under its centre, the views sharing a centre, and scaled by how many
+ * pixels each covers. The hottest tiles over SPLIT times the mean are
+ * split while there is room, then runs of tiles along a row predicted
+ * under the mean over MERGE are merged, as long as together they stay
+ * under the mean.
+ */
+void tilePlanner::plan(int64_t frame, double ratio){
+    if(!adapt){
+        return;
+    }
+    const uint64_t* old   = cells(frame);
+    int             cw    = 2 * tilesX;
+    int             tiles = tilesX * tilesY;
+    double          total = 0;
+    pred.assign(4 * tiles, 0);
+    cost.assign(tiles, 0);
+    order.resize(tiles);
+    split.assign(tiles, false);
+    out.clear();
+    for(int cy = 0; cy < 2 * tilesY; cy++){
+        for(int cx = 0; cx < cw; cx++){
+            tileBox b = cellBox(cx, cy);
+            if(area(b) == 0){
+                continue;
+            }
+            double x = width / 2.0 + ((b.left + b.right) / 2.0 -
+                    width / 2.0) * ratio;
+            double y = height / 2.0 + ((b.top + b.bottom) / 2.0 -
+                    height / 2.0) * ratio;
+            int    o = cellAt(x, y);
+            tileBox ob = cellBox(o % cw, o / cw);
+            pred[cy * cw + cx] = (uint64_t)((double)old[o] / area(ob) *
+                    area(b));
+            cost[(cy / 2) * tilesX + cx / 2] += pred[cy * cw + cx];
+            total += pred[cy * cw + cx];
+        }
+    }
+    double mean = total / tiles;
+    for(int t = 0; t < tiles; t++){
+        order[t] = std::make_pair(cost[t], t);
+    }
+    std::sort(order.rbegin(), order.rend());
+    for(int k = 0; k < tiles && 3 * (k + 1) <= cap - tiles; k++){
+        if(order[k].first <= SPLIT * mean){
+            break;
+        }
+        split[order[k].second] = true;
+    }
+    for(int ty = 0; ty < tilesY; ty++){
+        for(int tx = 0; tx < tilesX; tx++){
+            int       t = ty * tilesX + tx;
+            planPiece p;
+            if(split[t]){
+                for(int k = 0; k < 4; k++){
+                    int cx = 2 * tx + k % 2;
+                    int cy = 2 * ty + k / 2;
+                    p.box  = cellBox(cx, cy);
+                    p.cost = pred[cy * cw + cx];
+                    if(area(p.box) > 0){
+                        out.push_back(p);
+                    }
+                }
+                continue;
+            }
+            p.box        = cellBox(2 * tx, 2 * ty);
+            p.box.right  = cellBox(2 * tx + 1, 2 * ty).right;
+            p.box.bottom = cellBox(2 * tx, 2 * ty + 1).bottom;
+            p.cost       = cost[t];
+            for(int run = 1; run < MERGE_RUN && cost[t] * MERGE < mean &&
+                    tx + 1 < tilesX; run++){
+                int n = t + 1;
+                if(split[n] || cost[n] * MERGE >= mean ||
+                        p.cost + cost[n] >= mean){
+                    break;
+                }
+                p.box.right = cellBox(2 * tx + 3, 2 * ty).right;
+                p.cost     += cost[n];
+                tx++;
+                t = n;
+            }
+            out.push_back(p);
+        }
+    }
+    std::stable_sort(out.begin(), out.end(), costlier);
+    std::copy(out.begin(), out.end(), pieces(frame));
+    head(frame)->count = out.size();
+}
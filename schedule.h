@@ -0,0 +1,94 @@
+/**\file   schedule.h
+ * \date   October 16, 2026
+ *
+ * Plans the pieces each frame is rendered in from what an earlier frame
+ * cost. Consecutive frames of a zoom differ by a few percent, so the
+ * frame a ring's length back, scaled in by the zoom between the two,
+ * predicts where the next one will be slow. Tiles predicted hot are
+ * split in four, runs of cold ones are merged and the pieces are handed
+ * out costliest first, so a frame ends on small pieces rather than with
+ * most renderers idle behind one slow tile.
+ *
+ * Plans live in a shared mapping with one plan per ring slot, so -shm
+ * worker processes follow them as well as threads.
+ */
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <cstddef>           //!< size_t
+#include <cstdint>           //!< Fixed width integers
+#include <utility>           //!< Tiles paired with their costs
+#include <vector>            //!< Room to plan in
+
+/** Pixels from left to right and top to bottom, not counting right and
+ * bottom themselves.
+ */
+struct tileBox{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+struct planPiece{
+    tileBox  box;
+    uint64_t cost;           //!< Predicted iterations, plus one per pixel
+};
+
+/** Pieces are numbered in the order the ring hands them out. A plan has
+ * room for capacity() pieces and the ring hands out that many for every
+ * frame, the ones past the end of the plan being empty.
+ */
+class tilePlanner{
+public:
+    //!< A plan per slot for width by height frames in tiles of tile
+    //!< pixels. Unless adapt, every plan is the tiles in order.
+    tilePlanner(int width, int height, int tile, int slots, bool adapt);
+    ~tilePlanner();
+
+    bool ok() const { return plans != 0; }
+    int  capacity() const { return cap; }
+
+    //!< Piece i of a frame, false if the plan has fewer pieces
+    bool piece(int64_t frame, int i, tileBox* box) const;
+    //!< Notes what a rendered piece cost from the frame's iterations,
+    //!< which are stored a column at a time
+    void record(int64_t frame, const tileBox& box, const uint64_t* img);
+    //!< Plans the frame that takes over frame's slot from what frame
+    //!< cost. Call once frame is complete and before the slot is
+    //!< released. ratio is how much smaller the later frame's view is.
+    void plan(int64_t frame, double ratio);
+
+private:
+    struct planHead{
+        int32_t count;       //!< Pieces in the plan
+    };
+
+    tileBox   cellBox(int cx, int cy) const;
+    int       cellAt(double x, double y) const;
+    planHead* head(int64_t frame) const;
+    planPiece* pieces(int64_t frame) const;
+    uint64_t* cells(int64_t frame) const;
+
+    int    width;
+    int    height;
+    int    tile;
+    int    half;             //!< Width of the left and top cells of a tile
+    int    tilesX;
+    int    tilesY;
+    int    slots;
+    bool   adapt;
+    int    cap;              //!< Pieces a plan has room for
+    size_t stride;           //!< Bytes from one slot's plan to the next
+    size_t bytes;            //!< Size of the mapping
+    char*  plans;
+
+    // plan()'s working, kept so planning a frame allocates nothing
+    std::vector<uint64_t>                  pred;   //!< Per cell
+    std::vector<uint64_t>                  cost;   //!< Per tile
+    std::vector<std::pair<uint64_t, int> > order;  //!< Tiles, hottest first
+    std::vector<bool>                      split;
+    std::vector<planPiece>                 out;
+};
+
+#endif // SCHEDULE_H
@@ -0,0 +1,381 @@
+/**\file   shard.cpp
+ * \date   October 16, 2026
+ *
+ * Coordinator and worker ends of the frame sharding protocol. All
+ * sockets are blocking, the coordinator uses poll() to find out which
+ * worker has something to say and then reads the whole message. Only a
+ * hello has a time limit, so a connection that stops part way through
+ * one can't hold the coordinator up.
+ */
+
+#include "shard.h"
+#include "framepool.h"       //!< Recycled frame buffers
+#include <algorithm>         //!< Sorting requeued frames
+#include <cstdio>            //!< For writing out to console
+#include <cstring>           //!< memset for socket addresses
+#include <cerrno>            //!< EINTR
+#include <unistd.h>          //!< fork, read, write
+#include <poll.h>            //!< Waiting on several workers at once
+#include <netdb.h>           //!< getaddrinfo for -connect
+#include <arpa/inet.h>       //!< inet_pton for the bind address
+#include <netinet/in.h>      //!< sockaddr_in
+#include <netinet/tcp.h>     //!< TCP_NODELAY
+#include <sys/socket.h>      //!< Sockets
+#include <sys/time.h>        //!< timeval for the hello time limit
+#include <sys/wait.h>        //!< Reaping local workers
+
+/** Reads exactly n bytes, false on EOF or error */
+static bool readFull(int fd, void* buf, size_t n){
+    char* p = (char*)buf;
+    while(n > 0){
+        ssize_t r = read(fd, p, n);
+        if(r < 0 && errno == EINTR){
+            continue;
+        }
+        if(r <= 0){
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+/** Writes exactly n bytes without dying on a closed connection */
+static bool writeFull(int fd, const void* buf, size_t n){
+    const char* p = (const char*)buf;
+    while(n > 0){
+        ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+        if(r < 0 && errno == EINTR){
+            continue;
+        }
+        if(r <= 0){
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+static bool sendMsg(int fd, uint32_t type, int64_t frame, uint64_t len,
+        const uint64_t* payload, uint64_t view = 0){
+    shardMsg m;
+    m.magic = SHARD_MAGIC;
+    m.type  = type;
+    m.frame = frame;
+    m.len   = len;
+    m.view  = view;
+    if(!writeFull(fd, &m, sizeof(m))){
+        return false;
+    }
+    return !payload || writeFull(fd, payload, len * sizeof(uint64_t));
+}
+
+static void noDelay(int fd){
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+shardCoordinator::shardCoordinator(uint64_t pixels, uint64_t view,
+        int64_t first, int64_t end, int depth)
+    : pixels(pixels), view(view), next(first), end(end), drawn(first),
+      depth(depth < 1 ? 1 : depth), lfd(-1), lport(0), open(false),
+      joined(0){
+}
+
+shardCoordinator::~shardCoordinator(){
+    size_t i;
+    // Hanging up is the signal for workers to exit
+    for(i = 0; i < workers.size(); i++){
+        close(workers[i].fd);
+    }
+    for(i = 0; i < greeting.size(); i++){
+        close(greeting[i]);
+    }
+    if(lfd >= 0){
+        close(lfd);
+    }
+    for(i = 0; i < running.size(); i++){
+        waitpid(running[i], NULL, 0);
+    }
+    std::map<int64_t, uint64_t*>::iterator it;
+    for(it = done.begin(); it != done.end(); ++it){
+        giveFrame(it->second);
+    }
+}
+
+bool shardCoordinator::listen(const char* bind, int port){
+    sockaddr_in addr;
+    socklen_t   len = sizeof(addr);
+    int         one = 1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+    if(inet_pton(AF_INET, bind, &addr.sin_addr) != 1){
+        fprintf(stderr, "Bad shard bind address %s\n", bind);
+        return false;
+    }
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if(lfd < 0){
+        perror("socket");
+        return false;
+    }
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(::bind(lfd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+            ::listen(lfd, 64) != 0 ||
+            getsockname(lfd, (sockaddr*)&addr, &len) != 0){
+        perror("shard listen");
+        return false;
+    }
+    lport = ntohs(addr.sin_port);
+    open  = port != 0;
+    fprintf(stderr, "Shard coordinator on %s:%d\n", bind, lport);
+    return true;
+}
+
+bool shardCoordinator::spawnLocal(int n, shardRenderFn render, void* ctx){
+    for(int i = 0; i < n; i++){
+        pid_t pid = fork();
+        if(pid < 0){
+            perror("fork");
+            return false;
+        }
+        if(pid == 0){
+            close(lfd);
+            _exit(runShardWorker("127.0.0.1", lport, pixels, view, render,
+                        ctx));
+        }
+        children.push_back(pid);
+        running.push_back(pid);
+    }
+    return true;
+}
+
+/** Tops every worker up to depth frames, oldest lost frames first. */
+void shardCoordinator::assign(){
+    int64_t window = depth * (int64_t)(workers.empty() ? 1 : workers.size());
+    bool    gave   = true;
+    // Round robin one frame at a time so the work spreads evenly
+    while(gave){
+        gave = false;
+        for(size_t w = 0; w < workers.size(); w++){
+            int64_t f;
+            if((int)workers[w].pending.size() >= depth){
+                continue;
+            }
+            if(!retry.empty()){
+                f = retry.front();
+                retry.pop_front();
+            }else if(next < end && next < drawn + window){
+                f = next++;
+            }else{
+                return;
+            }
+            if(!sendMsg(workers[w].fd, SHARD_WORK, f, pixels, NULL)){
+                retry.push_front(f);
+                drop(w);
+                return;
+            }
+            workers[w].pending.push_back(f);
+            gave = true;
+        }
+    }
+}
+
+void shardCoordinator::accept(){
+    int      fd = ::accept(lfd, NULL, NULL);
+    timeval  t  = {2, 0};
+    if(fd < 0){
+        return;
+    }
+    // A hello cut off part way mustn't hang the coordinator either
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+    greeting.push_back(fd);
+}
+
+/** Reads the hello of a connection that has something to say and
+ * takes it on as a worker if it renders the same view.
+ * \return false if the connection was turned away
+ */
+bool shardCoordinator::hello(int fd){
+    shardMsg    m;
+    shardWorker w;
+    timeval     t = {0, 0};
+    if(!readFull(fd, &m, sizeof(m)) || m.magic != SHARD_MAGIC ||
+            m.type != SHARD_HELLO){
+        fprintf(stderr, "Rejected a shard worker that didn't say hello\n");
+        close(fd);
+        return false;
+    }
+    if(m.len != pixels || m.view != view){
+        fprintf(stderr, "Rejected a shard worker with a different view\n");
+        close(fd);
+        return false;
+    }
+    // Frames are read whole however long they take to arrive
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+    noDelay(fd);
+    w.fd = fd;
+    workers.push_back(w);
+    joined++;
+    fprintf(stderr, "Shard worker %d joined\n", joined);
+    return true;
+}
+
+/** Reads one finished frame from worker w. */
+bool shardCoordinator::receive(size_t w){
+    shardMsg  m;
+    uint64_t* buf;
+    if(!readFull(workers[w].fd, &m, sizeof(m)) || m.magic != SHARD_MAGIC ||
+            m.type != SHARD_FRAME || m.len != pixels ||
+            workers[w].pending.empty() ||
+            workers[w].pending.front() != m.frame){
+        return false;
+    }
+    buf = takeFrame(pixels);
+    if(!buf || !readFull(workers[w].fd, buf, pixels * sizeof(uint64_t))){
+        giveFrame(buf);
+        return false;
+    }
+    workers[w].pending.pop_front();
+    done[m.frame] = buf;
+    return true;
+}
+
+/** Forgets a worker and puts its frames back to be handed out again. */
+void shardCoordinator::drop(size_t w){
+    fprintf(stderr, "Lost a shard worker, %d frames requeued\n",
+            (int)workers[w].pending.size());
+    close(workers[w].fd);
+    retry.insert(retry.end(), workers[w].pending.begin(),
+            workers[w].pending.end());
+    std::sort(retry.begin(), retry.end());
+    workers.erase(workers.begin() + w);
+}
+
+/** Reaps forked workers that have exited.
+ * \return true if there is nobody left to render: no worker, none
+ * saying hello, no forked one still running and nobody else who knows
+ * the port
+ */
+bool shardCoordinator::deserted(){
+    for(size_t i = running.size(); i-- > 0;){
+        if(waitpid(running[i], NULL, WNOHANG) == running[i]){
+            running.erase(running.begin() + i);
+        }
+    }
+    return workers.empty() && greeting.empty() && running.empty() && !open;
+}
+
+const uint64_t* shardCoordinator::wait(int64_t frame){
+    bool warned = false;
+    while(done.find(frame) == done.end()){
+        size_t w, g, nw;
+        assign();
+        if(deserted()){
+            fprintf(stderr, "Every shard worker has exited\n");
+            return NULL;
+        }
+        std::vector<pollfd> fds(workers.size() + greeting.size() + 1);
+        // Local workers are still starting up until one has joined
+        if(workers.empty() && !warned && (children.empty() || joined > 0)){
+            fprintf(stderr, "Waiting for shard workers on port %d\n", lport);
+            warned = true;
+        }
+        for(w = 0; w < workers.size(); w++){
+            fds[w].fd     = workers[w].fd;
+            fds[w].events = POLLIN;
+        }
+        for(g = 0; g < greeting.size(); g++){
+            fds[w + g].fd     = greeting[g];
+            fds[w + g].events = POLLIN;
+        }
+        fds.back().fd     = lfd;
+        fds.back().events = POLLIN;
+        // A forked worker can die before it ever connects, which no
+        // descriptor would tell us about, so look in on them now and then
+        if(poll(&fds[0], fds.size(), running.empty() ? -1 : 200) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("poll");
+            return NULL;
+        }
+        // Walk backwards so dropping one keeps the indices valid, and
+        // workers first as hello() adds to the end of them
+        nw = workers.size();
+        for(w = nw; w-- > 0;){
+            if(fds[w].revents && !receive(w)){
+                drop(w);
+            }
+        }
+        for(g = greeting.size(); g-- > 0;){
+            if(fds[nw + g].revents){
+                int fd = greeting[g];
+                greeting.erase(greeting.begin() + g);
+                hello(fd);
+            }
+        }
+        if(fds.back().revents & POLLIN){
+            accept();
+        }
+    }
+    return done[frame];
+}
+
+void shardCoordinator::release(int64_t frame){
+    std::map<int64_t, uint64_t*>::iterator it = done.find(frame);
+    if(it != done.end()){
+        giveFrame(it->second);
+        done.erase(it);
+    }
+    drawn = frame + 1;
+}
+
+int runShardWorker(const char* host, int port, uint64_t pixels,
+        uint64_t view, shardRenderFn render, void* ctx){
+    addrinfo  hints;
+    addrinfo* res;
+    shardMsg  m;
+    char      svc[16];
+    int       fd = -1;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(svc, sizeof(svc), "%d", port);
+    if(getaddrinfo(host, svc, &hints, &res) != 0){
+        fprintf(stderr, "Couldn't resolve %s\n", host);
+        return 1;
+    }
+    for(addrinfo* a = res; a && fd < 0; a = a->ai_next){
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if(fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0){
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if(fd < 0){
+        fprintf(stderr, "Couldn't connect to %s:%d\n", host, port);
+        return 1;
+    }
+    noDelay(fd);
+    if(!sendMsg(fd, SHARD_HELLO, 0, pixels, NULL, view)){
+        close(fd);
+        return 1;
+    }
+    // The coordinator closing the connection means we are done
+    while(readFull(fd, &m, sizeof(m))){
+        if(m.magic != SHARD_MAGIC || m.type != SHARD_WORK){
+            close(fd);
+            return 1;
+        }
+        if(!sendMsg(fd, SHARD_FRAME, m.frame, pixels,
+                    render(ctx, m.frame))){
+            break;
+        }
+    }
+    close(fd);
+    return 0;
+}
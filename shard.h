@@ -0,0 +1,109 @@
+/**\file   shard.h
+ * \date   October 16, 2026
+ *
+ * Hands whole frames out to worker processes over TCP and collects the
+ * iteration buffers they send back. Local workers are forked and talk
+ * over loopback, anything else that runs `app -connect=host:port` with
+ * the same view flags can join the pool as well. Workers say which view
+ * they render as a hash when they join, and one with a different view
+ * is turned away.
+ */
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <cstdint>           //!< Fixed width integers
+#include <deque>             //!< Frames outstanding on each worker
+#include <map>               //!< Finished frames waiting to be drawn
+#include <vector>            //!< Worker list
+#include <sys/types.h>       //!< pid_t
+
+/** Renders a frame for a worker. Returns a buffer of iteration counts
+ * that stays valid until the next call.
+ */
+typedef const uint64_t* (*shardRenderFn)(void* ctx, int64_t frame);
+
+/** Header sent ahead of every message on a shard connection. Both ends
+ * are assumed to share byte order, which holds for loopback.
+ */
+struct shardMsg{
+    uint32_t magic;          //!< Always SHARD_MAGIC
+    uint32_t type;           //!< One of the SHARD_ message types
+    int64_t  frame;          //!< Frame the message is about
+    uint64_t len;            //!< Pixels in the frame, payload follows
+    uint64_t view;           //!< Hello only, the worker's view hash
+};
+
+//!< "MND2", the second version of the protocol, whose hello has a view.
+//!< Workers of the first, "MAND", are turned away.
+const uint32_t SHARD_MAGIC = 0x4d4e4432;
+const uint32_t SHARD_HELLO = 1;           //!< Worker joining the pool
+const uint32_t SHARD_WORK  = 2;           //!< Coordinator asking for a frame
+const uint32_t SHARD_FRAME = 3;           //!< Worker returning a frame
+
+struct shardWorker{
+    int                 fd;      //!< Connection to the worker
+    std::deque<int64_t> pending; //!< Frames sent, in the order asked for
+};
+
+/** Runs the accepting end. Frames are handed to whichever worker has
+ * room, at most depth per worker, and never more than a window of
+ * frames past the one being drawn so memory stays bounded. Frames lost
+ * with a worker are handed to another one. A new connection waits in
+ * the poll set like a worker until its hello arrives, so one that never
+ * says anything holds nothing up.
+ */
+class shardCoordinator{
+public:
+    //!< view is the hash workers must join with, see runShardWorker()
+    shardCoordinator(uint64_t pixels, uint64_t view, int64_t first,
+            int64_t end, int depth);
+    ~shardCoordinator();
+
+    //!< Starts listening, port 0 picks a free one that only forked
+    //!< workers are told about
+    bool listen(const char* bind, int port);
+    //!< Forks n workers that connect back over loopback
+    bool spawnLocal(int n, shardRenderFn render, void* ctx);
+    //!< Blocks until a frame has come back, NULL on failure or once
+    //!< every forked worker has exited and no other can join
+    const uint64_t* wait(int64_t frame);
+    //!< Hands a drawn frame's buffer back for reuse
+    void release(int64_t frame);
+    int  port() const { return lport; }
+    //!< Workers spawnLocal() forked, in the order it forked them
+    const std::vector<pid_t>& local() const { return children; }
+
+private:
+    void assign();
+    void accept();
+    bool hello(int fd);
+    bool receive(size_t w);
+    void drop(size_t w);
+    bool deserted();
+
+    uint64_t                     pixels;  //!< Size of each frame
+    uint64_t                     view;    //!< Hash of the view flags
+    int64_t                      next;    //!< Next frame never handed out
+    int64_t                      end;     //!< One past the last frame
+    int64_t                      drawn;   //!< Frames before this are done
+    int                          depth;   //!< Frames queued per worker
+    int                          lfd;     //!< Listening socket
+    int                          lport;
+    bool                         open;    //!< Others may join on lport
+    int                          joined;  //!< Workers ever accepted
+    std::vector<shardWorker>     workers;
+    std::vector<int>             greeting; //!< Accepted, hello to come
+    std::vector<pid_t>           children;
+    std::vector<pid_t>           running; //!< Children not yet reaped
+    std::deque<int64_t>          retry;   //!< Frames lost with a worker
+    std::map<int64_t, uint64_t*> done;    //!< Buffers from takeFrame()
+};
+
+/** Connects to a coordinator and renders frames until it hangs up.
+ * view is a hash of every setting that changes the frames rendered.
+ * \return 0 once the coordinator is finished, 1 on error
+ */
+int runShardWorker(const char* host, int port, uint64_t pixels,
+        uint64_t view, shardRenderFn render, void* ctx);
+
+#endif // SHARD_H
@@ -0,0 +1,31 @@
+/**\file   tilecost.cpp
+ * \date   October 16, 2026
+ *
+ * The shared mapping behind tileCosts. Anonymous mappings start zeroed,
+ * which marks every piece as not rendered yet. A table of no frames maps
+ * nothing and is never ok().
+ */
+
+#include "tilecost.h"
+#include <cstdio>            //!< perror
+#include <sys/mman.h>        //!< Shared anonymous mapping
+
+tileCosts::tileCosts(int64_t frames, int tiles)
+    : tiles(tiles), bytes(frames * tiles * sizeof(tileCost)), costs(0){
+    if(bytes == 0){
+        return;
+    }
+    void* m = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(m == MAP_FAILED){
+        perror("tile costs");
+        return;
+    }
+    costs = (tileCost*)m;
+}
+
+tileCosts::~tileCosts(){
+    if(costs){
+        munmap(costs, bytes);
+    }
+}
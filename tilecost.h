@@ -0,0 +1,60 @@
+/**\file   tilecost.h
+ * \date   October 16, 2026
+ *
+ * What each piece of each frame cost to render and which worker rendered
+ * it. The table lives in a shared mapping like the frame ring, so -shm
+ * worker processes fill it in as well as threads. Every piece has its
+ * own entry, written once by whoever rendered it, so no locking is
+ * needed.
+ */
+#ifndef TILECOST_H
+#define TILECOST_H
+
+#include <cstddef>           //!< size_t
+#include <cstdint>           //!< Fixed width integers
+#include <time.h>            //!< clock_gettime
+#include "schedule.h"        //!< tileBox
+
+struct tileCost{
+    tileBox  box;            //!< Pixels the piece covered
+    uint64_t start;          //!< Nanoseconds, CLOCK_MONOTONIC
+    uint64_t end;            //!< 0 until the tile has been rendered
+    uint64_t iterations;     //!< Escape iterations summed over the tile
+    int32_t  worker;         //!< Thread or process that rendered it
+};
+
+/** A clock every worker process agrees on */
+inline uint64_t costNow(){
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+class tileCosts{
+public:
+    tileCosts(int64_t frames, int tiles);
+    ~tileCosts();
+
+    bool ok() const { return costs != 0; }
+    int  size() const { return tiles; }
+
+    void record(int64_t frame, int tile, int worker, const tileBox& box,
+            uint64_t start, uint64_t end, uint64_t iterations){
+        tileCost& c  = costs[frame * tiles + tile];
+        c.box        = box;
+        c.start      = start;
+        c.end        = end;
+        c.iterations = iterations;
+        c.worker     = worker;
+    }
+    const tileCost& at(int64_t frame, int tile) const{
+        return costs[frame * tiles + tile];
+    }
+
+private:
+    int       tiles;         //!< Pieces the ring hands out per frame
+    size_t    bytes;         //!< Size of the mapping
+    tileCost* costs;
+};
+
+#endif // TILECOST_H
@@ -0,0 +1,273 @@
+/**\file   trace.cpp
+ * \date   October 16, 2026
+ *
+ * Per thread span buffers. A thread takes the lock once, to register its
+ * buffer, and never again while recording. Forked children save their
+ * spans to a file on the way out and the parent merges them, so a trace
+ * of -shm covers the worker processes as well.
+ */
+
+#include "trace.h"
+#include <algorithm>         //!< Sorting durations for percentiles
+#include <cstring>           //!< strncpy for thread names
+#include <map>               //!< Serial time per frame
+#include <vector>            //!< Span buffers
+#include <pthread.h>         //!< Guarding the buffer list
+#include <time.h>            //!< clock_gettime
+#include <unistd.h>          //!< getpid, unlink
+
+const char* PHASE_NAMES[PHASE_COUNT] = {"spawn", "render", "acquire",
+    "wait", "pace", "color", "flip", "checkpoint", "plan"};
+
+/** Everything one thread recorded */
+struct traceBuf{
+    int32_t                pid;
+    int32_t                tid;
+    char                   name[32];
+    std::vector<traceSpan> spans;
+};
+
+/** What traceSave() writes ahead of each thread's spans */
+struct traceFileHead{
+    int32_t  pid;
+    int32_t  tid;
+    char     name[32];
+    uint64_t count;
+};
+
+bool                          TRACE_ON = false;
+static uint64_t               epoch    = 0;    // when tracing started
+static std::vector<traceBuf*> bufs;
+static pthread_mutex_t        lock     = PTHREAD_MUTEX_INITIALIZER;
+static thread_local traceBuf* mine     = NULL;
+
+static uint64_t clockNs(){
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/** The calling thread's buffer, registered on first use */
+static traceBuf* myBuf(){
+    if(!mine){
+        mine = new traceBuf;
+        mine->pid = getpid();
+        mine->spans.reserve(4096);
+        pthread_mutex_lock(&lock);
+        mine->tid = bufs.size();
+        snprintf(mine->name, sizeof(mine->name), "thread %d", mine->tid);
+        bufs.push_back(mine);
+        pthread_mutex_unlock(&lock);
+    }
+    return mine;
+}
+
+void traceStart(){
+    epoch    = clockNs();
+    TRACE_ON = true;
+}
+
+uint64_t traceNow(){
+    return TRACE_ON ? clockNs() : 0;
+}
+
+void traceEnd(tracePhase phase, uint64_t start, int64_t frame, int tile){
+    if(!TRACE_ON){
+        return;
+    }
+    traceSpan s = {start, clockNs(), frame, phase, tile};
+    myBuf()->spans.push_back(s);
+}
+
+void traceThread(const char* name){
+    if(TRACE_ON){
+        strncpy(myBuf()->name, name, sizeof(mine->name) - 1);
+    }
+}
+
+void traceChild(const char* name){
+    if(!TRACE_ON){
+        return;
+    }
+    // Only the forking thread came along, and it may have forked while
+    // another thread held the lock
+    pthread_mutex_init(&lock, NULL);
+    for(size_t i = 0; i < bufs.size(); i++){
+        delete bufs[i];
+    }
+    bufs.clear();
+    mine = NULL;
+    traceThread(name);
+}
+
+bool traceSave(const char* path){
+    FILE* f = fopen(path, "wb");
+    if(!f){
+        return false;
+    }
+    for(size_t i = 0; i < bufs.size(); i++){
+        traceFileHead h;
+        h.pid   = bufs[i]->pid;
+        h.tid   = bufs[i]->tid;
+        h.count = bufs[i]->spans.size();
+        memcpy(h.name, bufs[i]->name, sizeof(h.name));
+        fwrite(&h, sizeof(h), 1, f);
+        fwrite(bufs[i]->spans.data(), sizeof(traceSpan), h.count, f);
+    }
+    return fclose(f) == 0;
+}
+
+bool traceMerge(const char* path){
+    FILE*         f = fopen(path, "rb");
+    traceFileHead h;
+    if(!f){
+        return false;
+    }
+    while(fread(&h, sizeof(h), 1, f) == 1){
+        traceBuf* b = new traceBuf;
+        b->pid = h.pid;
+        b->tid = h.tid;
+        memcpy(b->name, h.name, sizeof(b->name));
+        b->spans.resize(h.count);
+        if(fread(b->spans.data(), sizeof(traceSpan), h.count, f) != h.count){
+            delete b;
+            break;
+        }
+        pthread_mutex_lock(&lock);
+        bufs.push_back(b);
+        pthread_mutex_unlock(&lock);
+    }
+    fclose(f);
+    unlink(path);
+    return true;
+}
+
+/** Time the drawer spent on each frame, keyed by frame, with when it
+ * finished with the frame. Only frames drawn by this process count.
+ */
+static void serialTimes(std::map<int64_t, std::pair<uint64_t, uint64_t> >*
+        frames){
+    int32_t pid = getpid();
+    for(size_t i = 0; i < bufs.size(); i++){
+        if(bufs[i]->pid != pid){
+            continue;
+        }
+        const std::vector<traceSpan>& v = bufs[i]->spans;
+        for(size_t k = 0; k < v.size(); k++){
+            if(v[k].phase != PHASE_COLOR && v[k].phase != PHASE_FLIP &&
+                    v[k].phase != PHASE_CHECKPOINT &&
+                    v[k].phase != PHASE_PLAN){
+                continue;
+            }
+            std::pair<uint64_t, uint64_t>& p = (*frames)[v[k].frame];
+            p.first += v[k].end - v[k].start;
+            p.second = std::max(p.second, v[k].end);
+        }
+    }
+}
+
+/**\brief The fraction of each frame's drawing cycle spent on work only
+ * the drawer can do.
+ *
+ * A cycle runs from the drawer finishing one frame to finishing the
+ * next, so its waits on the renderers count against it.
+ */
+static void serialFractions(std::vector<std::pair<int64_t, double> >* out){
+    std::map<int64_t, std::pair<uint64_t, uint64_t> > frames;
+    serialTimes(&frames);
+    std::map<int64_t, std::pair<uint64_t, uint64_t> >::iterator it, prev;
+    for(it = frames.begin(); it != frames.end(); ++it){
+        if(it == frames.begin()){
+            prev = it;
+            continue;
+        }
+        uint64_t cycle = it->second.second - prev->second.second;
+        if(cycle > 0){
+            out->push_back(std::make_pair(it->first,
+                        (double)it->second.first / cycle));
+        }
+        prev = it;
+    }
+}
+
+bool traceWrite(const char* path){
+    FILE* f = fopen(path, "w");
+    bool  first = true;
+    if(!f){
+        return false;
+    }
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for(size_t i = 0; i < bufs.size(); i++){
+        const traceBuf* b = bufs[i];
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+                "\"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",\n", b->pid, b->tid, b->name);
+        first = false;
+        for(size_t k = 0; k < b->spans.size(); k++){
+            const traceSpan& s = b->spans[k];
+            fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                    "\"dur\": %.3f, \"pid\": %d, \"tid\": %d, "
+                    "\"args\": {\"frame\": %ld, \"tile\": %d}}",
+                    PHASE_NAMES[s.phase], (s.start - epoch) / 1e3,
+                    (s.end - s.start) / 1e3, b->pid, b->tid,
+                    (long)s.frame, s.tile);
+        }
+    }
+    // A counter track right under the drawer's spans
+    std::map<int64_t, std::pair<uint64_t, uint64_t> > frames;
+    std::vector<std::pair<int64_t, double> >          serial;
+    serialTimes(&frames);
+    serialFractions(&serial);
+    for(size_t i = 0; i < serial.size(); i++){
+        fprintf(f, ",\n{\"name\": \"serial fraction\", \"ph\": \"C\", "
+                "\"ts\": %.3f, \"pid\": %d, \"args\": {\"serial\": %.4f}}",
+                (frames[serial[i].first].second - epoch) / 1e3, getpid(),
+                serial[i].second);
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+/** Nearest rank percentile of sorted values */
+static double percentile(const std::vector<double>& v, double p){
+    size_t k = (size_t)(p / 100.0 * v.size());
+    return v[k < v.size() ? k : v.size() - 1];
+}
+
+void traceSummary(FILE* out){
+    std::vector<double> ms[PHASE_COUNT];
+    for(size_t i = 0; i < bufs.size(); i++){
+        const std::vector<traceSpan>& v = bufs[i]->spans;
+        for(size_t k = 0; k < v.size(); k++){
+            ms[v[k].phase].push_back((v[k].end - v[k].start) / 1e6);
+        }
+    }
+    fprintf(out, "%-11s %8s %10s %9s %9s %9s %9s\n", "phase", "count",
+            "total ms", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for(int p = 0; p < PHASE_COUNT; p++){
+        double total = 0;
+        if(ms[p].empty()){
+            continue;
+        }
+        std::sort(ms[p].begin(), ms[p].end());
+        for(size_t k = 0; k < ms[p].size(); k++){
+            total += ms[p][k];
+        }
+        fprintf(out, "%-11s %8lu %10.1f %9.3f %9.3f %9.3f %9.3f\n",
+                PHASE_NAMES[p], (unsigned long)ms[p].size(), total,
+                percentile(ms[p], 50), percentile(ms[p], 90),
+                percentile(ms[p], 99), ms[p].back());
+    }
+    std::vector<std::pair<int64_t, double> > serial;
+    std::vector<double>                      fr;
+    serialFractions(&serial);
+    for(size_t i = 0; i < serial.size(); i++){
+        fr.push_back(serial[i].second * 100.0);
+    }
+    if(!fr.empty()){
+        std::sort(fr.begin(), fr.end());
+        fprintf(out, "serial %% of each frame: p50 %.1f p90 %.1f p99 %.1f "
+                "max %.1f\n", percentile(fr, 50), percentile(fr, 90),
+                percentile(fr, 99), fr.back());
+    }
+}
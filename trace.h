@@ -0,0 +1,77 @@
+/**\file   trace.h
+ * \date   October 16, 2026
+ *
+ * Timestamped spans around the phases of each frame, kept per thread so
+ * recording one is two clock reads and an append with no locking.
+ * Nothing is recorded unless traceStart() turned it on. At exit the
+ * spans are written out as a Chrome trace, for chrome://tracing or
+ * Perfetto, and summarised as percentiles per phase.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>           //!< Fixed width integers
+#include <cstdio>            //!< FILE for the summary
+
+/** What a span of time was spent on */
+enum tracePhase{
+    PHASE_SPAWN,             //!< Starting render threads or processes
+    PHASE_RENDER,            //!< Rendering a piece, or a whole shard frame
+    PHASE_ACQUIRE,           //!< Renderer waiting for a free ring slot
+    PHASE_WAIT,              //!< Drawer waiting for the next frame
+    PHASE_PACE,              //!< Drawer holding a frame back for -fps
+    PHASE_COLOR,             //!< Colouring a frame into the surface
+    PHASE_FLIP,              //!< SDL_Flip
+    PHASE_CHECKPOINT,        //!< Writing the checkpoint
+    PHASE_PLAN,              //!< Planning the frame that takes the slot
+    PHASE_COUNT
+};
+
+struct traceSpan{
+    uint64_t start;          //!< Nanoseconds, CLOCK_MONOTONIC
+    uint64_t end;
+    int64_t  frame;          //!< Frame worked on, -1 for none
+    int32_t  phase;          //!< A tracePhase
+    int32_t  tile;           //!< Tile, -1 for none
+};
+
+extern bool TRACE_ON;        //!< Whether spans are being recorded
+
+//!< Turns recording on for this process and whatever it forks
+void     traceStart();
+//!< Current time for the start of a span, 0 while tracing is off
+uint64_t traceNow();
+//!< Records a span for the calling thread from start until now
+void     traceEnd(tracePhase phase, uint64_t start, int64_t frame,
+        int tile = -1);
+//!< Names the calling thread in the trace
+void     traceThread(const char* name);
+//!< Called first thing in a forked child, drops the parent's spans
+void     traceChild(const char* name);
+//!< Dumps a child's spans for the parent to pick up with traceMerge()
+bool     traceSave(const char* path);
+//!< Adds the spans a child saved to this process's and removes the file
+bool     traceMerge(const char* path);
+//!< Writes every span as Chrome trace JSON
+bool     traceWrite(const char* path);
+//!< Prints percentiles per phase and of the drawer's serial fraction
+void     traceSummary(FILE* out);
+
+/** Records a span from construction to destruction. */
+class traceScope{
+public:
+    traceScope(tracePhase phase, int64_t frame, int tile = -1)
+        : phase(phase), frame(frame), tile(tile), start(traceNow()){
+    }
+    ~traceScope(){
+        traceEnd(phase, start, frame, tile);
+    }
+
+private:
+    tracePhase phase;
+    int64_t    frame;
+    int        tile;
+    uint64_t   start;
+};
+
+#endif // TRACE_H
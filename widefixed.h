@@ -0,0 +1,139 @@
+/**\file   widefixed.h
+ * \date   October 16, 2026
+ *
+ * Signed fixed point numbers N 64 bit limbs wide, 128, 192 or 256 bits
+ * for N of 2, 3 or 4. The top 8 bits are the sign and integer part,
+ * enough for |z|^2 just after z^2 + c or z^3 + c has escaped but not
+ * z^4 + c, the rest is fraction. Products go through 64x64 to 128
+ * bit multiplies and carry chains, which compile to mulx and adc/adx.
+ * For mid-depth zooms this beats every floating point type wider than
+ * long double.
+ */
+#ifndef WIDEFIXED_H
+#define WIDEFIXED_H
+
+#include <cmath>             //!< ldexpl and fabsl for conversions
+#include <cstdint>           //!< Fixed width integers
+
+typedef unsigned __int128 uint128_t;
+
+template<int N>
+struct wideFixed{
+    static const int FRAC = 64 * N - 8;  //!< Bits after the point
+    static const int TOP  = 56;          //!< Fraction bits in l[N-1]
+
+    uint64_t l[N];           //!< Limbs, least significant first
+
+    wideFixed(){
+    }
+    wideFixed(double v){
+        *this = wideFixed((long double)v);
+    }
+    //!< Exact for every long double in range
+    explicit wideFixed(long double v){
+        long double a = ldexpl(fabsl(v), TOP);
+        for(int k = N - 1; k >= 0; k--){
+            l[k] = (uint64_t)a;
+            a    = ldexpl(a - l[k], 64);
+        }
+        if(v < 0){
+            negateIf(~0ULL);
+        }
+    }
+    //!< Two's complement negation when mask is all ones, branch free
+    void negateIf(uint64_t mask){
+        uint64_t c = mask & 1;
+        for(int k = 0; k < N; k++){
+            uint128_t t = (uint128_t)(l[k] ^ mask) + c;
+            l[k] = (uint64_t)t;
+            c    = (uint64_t)(t >> 64);
+        }
+    }
+    //!< All ones if negative, zero otherwise
+    uint64_t signMask() const{
+        return (uint64_t)((int64_t)l[N - 1] >> 63);
+    }
+};
+
+template<int N>
+inline wideFixed<N> operator+(wideFixed<N> a, const wideFixed<N>& b){
+    uint64_t c = 0;
+    for(int k = 0; k < N; k++){
+        uint128_t t = (uint128_t)a.l[k] + b.l[k] + c;
+        a.l[k] = (uint64_t)t;
+        c      = (uint64_t)(t >> 64);
+    }
+    return a;
+}
+
+template<int N>
+inline wideFixed<N> operator-(wideFixed<N> a){
+    a.negateIf(~0ULL);
+    return a;
+}
+
+template<int N>
+inline wideFixed<N> operator-(const wideFixed<N>& a, const wideFixed<N>& b){
+    return a + -b;
+}
+
+/** Product of two non-negative numbers, rounded down to FRAC bits */
+template<int N>
+inline wideFixed<N> mulAbs(const wideFixed<N>& a, const wideFixed<N>& b){
+    uint64_t     p[2 * N] = {0};
+    wideFixed<N> r;
+    for(int i = 0; i < N; i++){
+        uint64_t c = 0;
+        for(int j = 0; j < N; j++){
+            uint128_t t = (uint128_t)a.l[i] * b.l[j] + p[i + j] + c;
+            p[i + j] = (uint64_t)t;
+            c        = (uint64_t)(t >> 64);
+        }
+        p[i + N] = c;
+    }
+    // The product has 2*FRAC fraction bits, drop FRAC of them
+    for(int k = 0; k < N; k++){
+        r.l[k] = (p[k + N - 1] >> (64 - 8)) | (p[k + N] << 8);
+    }
+    return r;
+}
+
+template<int N>
+inline wideFixed<N> operator*(wideFixed<N> a, wideFixed<N> b){
+    uint64_t sa = a.signMask();
+    uint64_t sb = b.signMask();
+    a.negateIf(sa);
+    b.negateIf(sb);
+    wideFixed<N> r = mulAbs(a, b);
+    r.negateIf(sa ^ sb);
+    return r;
+}
+
+template<int N>
+inline wideFixed<N> sqr(wideFixed<N> a){
+    a.negateIf(a.signMask());
+    return mulAbs(a, a);
+}
+
+template<int N>
+inline wideFixed<N> twice(wideFixed<N> a){
+    for(int k = N - 1; k > 0; k--){
+        a.l[k] = (a.l[k] << 1) | (a.l[k - 1] >> 63);
+    }
+    a.l[0] <<= 1;
+    return a;
+}
+
+template<int N>
+inline wideFixed<N> absolute(wideFixed<N> a){
+    a.negateIf(a.signMask());
+    return a;
+}
+
+//!< Only the top limb, plenty for comparing against the escape radius
+template<int N>
+inline double toDouble(const wideFixed<N>& a){
+    return ldexp((double)(int64_t)a.l[N - 1], -wideFixed<N>::TOP);
+}
+
+#endif // WIDEFIXED_H